@@ -10,6 +10,16 @@
  * 	ld with  -N -T 0
  * to make sure the object file has no shared text.
  *
+ * The output is in version 2 of the format (see noff.h): each segment is
+ * stored at the same distance from the start of the file as from address
+ * 0, plus a page aligned header area, so that every page of the program
+ * image is a single, aligned sector of the NOFF file: the kernel then
+ * loads pages straight from their sector, on demand.
+ *
+ * Options:
+ *	-z	compress each page of the image
+ *	-s	keep the symbol table of the COFF file
+ *
  * Also assumes that the COFF file has at most 3 segments:
  *	.text	-- read-only executable instructions 
  *	.data	-- initialized data
@@ -35,6 +45,7 @@
 
 #include "coff.h"
 #include "noff.h"
+#include "lzcodec.h"
 
 /* Routines for converting words and short words to and from the
  * simulated machine's format of little endian.  These end up
@@ -69,6 +80,13 @@ ShortToHost(unsigned short shortword) {
 
 #define ReadStruct(f,s) 	Read(f,(char *)&s,sizeof(s))
 
+/* Must match PageSize and SectorSize in the kernel */
+#define NoffPageSize	128
+
+/* Where the image starts in the NOFF file: right after the header */
+#define NoffImageBase	(((sizeof(NoffHeader2) + NoffPageSize - 1) \
+			  / NoffPageSize) * NoffPageSize)
+
 char *noffFileName = NULL;
 
 /* read and check for error */
@@ -91,17 +109,63 @@ void Write(int fd, char *buf, int nBytes)
     }
 }
 
+/* Writes the image compressed page by page, followed by its page index
+ * (little endian, like the MIPS), from "position" on.  Returns the
+ * position of the index.
+ */
+static int WriteCompressed(int fd, char *image, int size, int position)
+{
+    int numPages = (size + NoffPageSize - 1) / NoffPageSize;
+    int *index = malloc((numPages + 1) * sizeof(int));
+    char page[NoffPageSize], packed[NoffPageSize];
+    int i, n;
+
+    lseek(fd, position, 0);
+    for (i = 0; i < numPages; i++) {
+	memset(page, 0, NoffPageSize);
+	n = size - i * NoffPageSize;
+	memcpy(page, image + i * NoffPageSize, n < NoffPageSize ? n : NoffPageSize);
+
+	index[i] = WordToHost(position);
+	n = LzCompress(page, NoffPageSize, packed, NoffPageSize - 1);
+	if (n > 0) {
+	    Write(fd, packed, n);
+	    position += n;
+	} else {
+	    Write(fd, page, NoffPageSize);
+	    position += NoffPageSize;
+	}
+    }
+    index[numPages] = WordToHost(position);
+    Write(fd, (char *) index, (numPages + 1) * sizeof(int));
+    free(index);
+    return position;
+}
+
 int main (int argc, char **argv)
 {
-    int fdIn, fdOut, numsections, i, inNoffFile;
+    int fdIn, fdOut, numsections, i;
     struct filehdr fileh;
     struct aouthdr systemh;
     struct scnhdr *sections;
     char *buffer;
-    NoffHeader noffH;
+    char *image;
+    int imageSize;
+    int compress = 0, symbols = 0;
+    NoffHeader2 noffH;
 
-    if (argc < 2) {
-	fprintf(stderr, "Usage: %s <coffFileName> <noffFileName>\n", argv[0]);
+    while (argc > 1 && argv[1][0] == '-') {
+	if (!strcmp(argv[1], "-z"))
+	    compress = 1;
+	else if (!strcmp(argv[1], "-s"))
+	    symbols = 1;
+	else
+	    break;
+	argc--;
+	argv++;
+    }
+    if (argc < 3) {
+	fprintf(stderr, "Usage: %s [-z] [-s] <coffFileName> <noffFileName>\n", argv[0]);
 	exit(1);
     }
     
@@ -124,6 +188,7 @@ int main (int argc, char **argv)
     ReadStruct(fdIn,fileh);
     fileh.f_magic = ShortToHost(fileh.f_magic);
     fileh.f_nscns = ShortToHost(fileh.f_nscns); 
+    fileh.f_symptr = WordToHost(fileh.f_symptr);
     if (fileh.f_magic != MIPSELMAGIC) {
 	fprintf(stderr, "File is not a MIPSEL COFF file\n");
         unlink(noffFileName);
@@ -154,14 +219,26 @@ int main (int argc, char **argv)
  /* initialize the NOFF header, in case not all the segments are defined
   * in the COFF file
   */
-    noffH.noffMagic = NOFFMAGIC;
-    noffH.code.size = 0;
-    noffH.initData.size = 0;
-    noffH.uninitData.size = 0;
+    memset(&noffH, 0, sizeof(noffH));
+    noffH.noffMagic = NOFFMAGIC2;
+    noffH.entryPoint = WordToHost(systemh.entry);
+    noffH.codeFlags = NOFF_READ | NOFF_EXEC;
+    noffH.initDataFlags = NOFF_READ | NOFF_WRITE;
+    noffH.uninitDataFlags = NOFF_READ | NOFF_WRITE;
+
+ /* The image (code and data) is first built in memory, as it will be in
+  * the virtual address space
+  */
+    imageSize = 0;
+    for (i = 0; i < numsections; i++)
+	if (sections[i].s_size > 0 && (!strncmp(sections[i].s_name, ".text", 8)
+	    || !strncmp(sections[i].s_name, ".data", 8)
+	    || !strcmp(sections[i].s_name, ".rdata"))
+	    && sections[i].s_paddr + sections[i].s_size > imageSize)
+	    imageSize = sections[i].s_paddr + sections[i].s_size;
+    image = calloc(imageSize > 0 ? imageSize : 1, 1);
 
  /* Copy the segments in */
-    inNoffFile = sizeof(NoffHeader);
-    lseek(fdOut, inNoffFile, 0);
     printf("Loading %d sections:\n", numsections);
     for (i = 0; i < numsections; i++) {
 	printf("\t\"%.8s\", filepos 0x%lx, mempos 0x%lx, size 0x%lx, flags 0x%lx\n",
@@ -172,14 +249,10 @@ int main (int argc, char **argv)
 		/* do nothing! */	
 	} else if (!strncmp(sections[i].s_name, ".text", 8)) {
 	    noffH.code.virtualAddr = sections[i].s_paddr;
-	    noffH.code.inFileAddr = inNoffFile;
+	    noffH.code.inFileAddr = NoffImageBase + sections[i].s_paddr;
 	    noffH.code.size = sections[i].s_size;
     	    lseek(fdIn, sections[i].s_scnptr, 0);
-    	    buffer = malloc(sections[i].s_size);
-    	    Read(fdIn, buffer, sections[i].s_size);
-    	    Write(fdOut, buffer, sections[i].s_size);
-    	    free(buffer);
-	    inNoffFile += sections[i].s_size;
+    	    Read(fdIn, image + sections[i].s_paddr, sections[i].s_size);
 	} else if (!strncmp(sections[i].s_name, ".data", 8)
 	  		|| !strcmp(sections[i].s_name, ".rdata")) {
   	    /* need to check if we have both .data and .rdata 
@@ -190,14 +263,10 @@ int main (int argc, char **argv)
 	        exit(1);
 	    }
 	    noffH.initData.virtualAddr = sections[i].s_paddr;
-	    noffH.initData.inFileAddr = inNoffFile;
+	    noffH.initData.inFileAddr = NoffImageBase + sections[i].s_paddr;
 	    noffH.initData.size = sections[i].s_size;
     	    lseek(fdIn, sections[i].s_scnptr, 0);
-    	    buffer = malloc(sections[i].s_size);
-    	    Read(fdIn, buffer, sections[i].s_size);
-    	    Write(fdOut, buffer, sections[i].s_size);
-    	    free(buffer);
-	    inNoffFile += sections[i].s_size;
+    	    Read(fdIn, image + sections[i].s_paddr, sections[i].s_size);
 	} else if (!strncmp(sections[i].s_name, ".bss", 8) ||
 			!strcmp(sections[i].s_name, ".sbss")) {
   	    /* need to check if we have both .bss and .sbss -- make sure they 
@@ -247,8 +316,38 @@ int main (int argc, char **argv)
 	    exit(1);
 	}
     }
+
+ /* then written out, compressed or as is, and followed by the symbols */
+    if (compress) {
+	noffH.imageFlags = NOFF_COMPRESSED;
+	noffH.pageIndex = WriteCompressed(fdOut, image, imageSize, NoffImageBase);
+	noffH.symbols.inFileAddr = noffH.pageIndex
+	    + ((imageSize + NoffPageSize - 1) / NoffPageSize + 1) * sizeof(int);
+    } else {
+	lseek(fdOut, NoffImageBase, 0);
+	Write(fdOut, image, imageSize);
+	noffH.symbols.inFileAddr = NoffImageBase + imageSize;
+    }
+    free(image);
+
+    if (symbols && fileh.f_symptr > 0) {
+	int end = lseek(fdIn, 0, SEEK_END);
+	noffH.symbols.size = end - fileh.f_symptr;
+	buffer = malloc(noffH.symbols.size);
+	lseek(fdIn, fileh.f_symptr, 0);
+	Read(fdIn, buffer, noffH.symbols.size);
+	lseek(fdOut, noffH.symbols.inFileAddr, 0);
+	Write(fdOut, buffer, noffH.symbols.size);
+	free(buffer);
+    } else {
+	noffH.symbols.inFileAddr = 0;
+    }
+    printf("Image of %d bytes%s, entry point 0x%x, %d bytes of symbols\n",
+	   imageSize, compress ? " (compressed)" : "", noffH.entryPoint,
+	   noffH.symbols.size);
+
     lseek(fdOut, 0, 0);
-    Write(fdOut, (char *)&noffH, sizeof(NoffHeader));
+    Write(fdOut, (char *)&noffH, sizeof(NoffHeader2));
     close(fdIn);
     close(fdOut);
     exit(0);
@@ -23,3 +23,43 @@ typedef struct noffHeader {
 				 * should be zero'ed before use 
 				 */
 } NoffHeader;
+
+/* Version 2 of the format.  Its header starts like the version 1 one,
+ * and the segments are laid out as in memory, from a page aligned base
+ * (so that each page of the program image is a single sector), which
+ * lets the kernel map the image straight from the file.  uninitData has
+ * no bytes in the file, it is zero-filled on demand.
+ */
+#define NOFFMAGIC2	0xbadfae
+
+/* Segment flags */
+#define NOFF_READ	0x1
+#define NOFF_WRITE	0x2
+#define NOFF_EXEC	0x4
+
+/* Image flags */
+#define NOFF_COMPRESSED	0x1	/* each page of the image is compressed on
+				 * its own with the LZ codec of 
+				 * userprog/lzcodec.h; pageIndex gives
+				 * the position in the file of the
+				 * (number of image pages + 1) ints
+				 * delimiting them.  A page of PageSize
+				 * bytes is stored as is.
+				 */
+
+typedef struct noffHeader2 {
+   int noffMagic;		/* should be NOFFMAGIC2 */
+   Segment code;		/* as in version 1 */
+   Segment initData;
+   Segment uninitData;
+   int entryPoint;		/* initial value of the pc */
+   int codeFlags;		/* NOFF_READ, NOFF_WRITE, NOFF_EXEC */
+   int initDataFlags;
+   int uninitDataFlags;
+   int imageFlags;		/* NOFF_COMPRESSED */
+   int pageIndex;		/* see NOFF_COMPRESSED */
+   Segment symbols;		/* MIPS symbol table copied from the COFF
+				 * file (virtualAddr unused), size 0 if
+				 * it was not kept
+				 */
+} NoffHeader2;
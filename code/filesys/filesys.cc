@@ -30,7 +30,8 @@
 //
 // 	Our implementation at this point has the following restrictions:
 //
-//	   there is no synchronization for concurrent accesses
+//	   the directories and the free map are protected by reader-writer
+//	     locks, but concurrent writes to a file are not synchronized
 //	   files have a fixed size, set when the file is created
 //	   files cannot be bigger than about 3KB in size
 //	   there is no hierarchical directory structure, and only a limited
@@ -56,6 +57,7 @@
 #include <iostream>
 
 #include "system.h"
+#include "synch.h"
 #include <libgen.h>
 #include <list>
 #include <string>
@@ -89,6 +91,8 @@
 FileSystem::FileSystem(bool format)
 { 
     DEBUG('f', "Initializing the file system.\n");
+    dirLock = new RWLock("directory lock");
+    mapLock = new RWLock("free map lock");
     if (format) {
         BitMap *freeMap = new BitMap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
@@ -199,14 +203,22 @@ FileSystem::FileSystem(bool format)
 //	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
 //
-// 	Note that this implementation assumes there is no concurrent access
-//	to the file system!
+// 	Create holds dirLock for writing, so that two threads cannot add
+//	the same name, and mapLock while it takes sectors from the free
+//	map.  Lookups (Open) only share dirLock for reading.
 //
 //	"name" -- name of file to be created
 //	"initialSize" -- size of file to be created
 //----------------------------------------------------------------------
 
 bool FileSystem::Create(const char *name, FileHeader::FileType type) {
+    dirLock->AcquireWrite();
+    bool success = DoCreate(name, type);
+    dirLock->ReleaseWrite();
+    return success;
+}
+
+bool FileSystem::DoCreate(const char *name, FileHeader::FileType type) {
 
     Directory *directory;
     BitMap *freeMap;
@@ -221,6 +233,7 @@ bool FileSystem::Create(const char *name, FileHeader::FileType type) {
     if (directory->Find(name) != -1)
       success = FALSE;			// file is already in directory
     else {	
+        mapLock->AcquireWrite();
         freeMap = new BitMap(NumSectors);
         freeMap->FetchFrom(freeMapFile);
         sector = freeMap->Find();	// find a sector to hold the file header
@@ -249,6 +262,7 @@ bool FileSystem::Create(const char *name, FileHeader::FileType type) {
 	    }
             delete hdr;
 	}
+        mapLock->ReleaseWrite();
         delete freeMap;
     }
     delete directory;
@@ -267,6 +281,15 @@ bool FileSystem::Create(const char *name, FileHeader::FileType type) {
 
 OpenFile *
 FileSystem::Open(const char *name)
+{ 
+    dirLock->AcquireRead();
+    OpenFile *openFile = DoOpen(name);
+    dirLock->ReleaseRead();
+    return openFile;
+}
+
+OpenFile *
+FileSystem::DoOpen(const char *name)
 { 
     Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
@@ -306,16 +329,19 @@ FileSystem::Remove(const char *name)
     FileHeader *fileHdr;
     int sector;
     
+    dirLock->AcquireWrite();
     directory = new Directory(NumDirEntries);
     directory->FetchFrom(directoryFile);
     sector = directory->Find(name);
     if (sector == -1) {
+       dirLock->ReleaseWrite();
        delete directory;
        return FALSE;			 // file not found 
     }
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
 
+    mapLock->AcquireWrite();
     freeMap = new BitMap(NumSectors);
     freeMap->FetchFrom(freeMapFile);
 
@@ -325,7 +351,9 @@ FileSystem::Remove(const char *name)
     directory->Remove(name);
 
     freeMap->WriteBack(freeMapFile);		// flush to disk
+    mapLock->ReleaseWrite();
     directory->WriteBack(directoryFile);        // flush to disk
+    dirLock->ReleaseWrite();
     delete fileHdr;
     delete directory;
     delete freeMap;
@@ -342,8 +370,10 @@ FileSystem::List()
 {
     Directory *directory = new Directory(NumDirEntries);
 
+    dirLock->AcquireRead();
     directory->FetchFrom(directoryFile);
     directory->List();
+    dirLock->ReleaseRead();
     delete directory;
 }
 
@@ -373,11 +403,15 @@ FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
+    dirLock->AcquireRead();
+    mapLock->AcquireRead();
     freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
+    mapLock->ReleaseRead();
 
     directory->FetchFrom(directoryFile);
     directory->Print();
+    dirLock->ReleaseRead();
 
     delete bitHdr;
     delete dirHdr;
@@ -389,6 +423,13 @@ FileSystem::Print()
 
 /*The following function sets the path of the current folder  */
 bool FileSystem::Directory_path(const char* name) {
+    dirLock->AcquireWrite();
+    bool found = DoPath(name);
+    dirLock->ReleaseWrite();
+    return found;
+}
+
+bool FileSystem::DoPath(const char* name) {
     char* slash = NULL;
     char* dir = (char*) name;
 
@@ -445,7 +486,7 @@ bool FileSystem::Directory_path(const char* name) {
             delete fileheader;
             if (type == FileHeader::DIRECTORY) {
                 OpenFile* fp2 = directoryFile;
-                directoryFile = Open(dirName);
+                directoryFile = DoOpen(dirName);
                 if (fp2 != fp) {
                     delete fp2;
                 }
@@ -481,11 +522,12 @@ bool FileSystem::CreateDirectory(const char *name) {
     // Create the new folder and writes a data structure to Directory
     Directory *directory;
 
-    Create(name, FileHeader::DIRECTORY);
+    dirLock->AcquireWrite();
+    DoCreate(name, FileHeader::DIRECTORY);
 
     directory = new Directory(NumDirEntries);
 
-    OpenFile* newDirectory = Open(name);  //Open 'name' file for reading and writing.  
+    OpenFile* newDirectory = DoOpen(name);  //Open 'name' file for reading and writing.  
 
     directory->WriteBack(newDirectory);    // Write modifications to the newDirectory back to disk
 
@@ -515,13 +557,13 @@ bool FileSystem::CreateDirectory(const char *name) {
 
 
     // Proceed into the new folder to create "." and ".."
-    Directory_path((std::string(name) + "/").c_str());
+    DoPath((std::string(name) + "/").c_str());
 
 
     //Create the  directory and parent header
-    Create(".", FileHeader::DOTLINK);    // Create a "." directory
+    DoCreate(".", FileHeader::DOTLINK);    // Create a "." directory
 
-    Create("..", FileHeader::DOTLINK);   // Create a ".." directory
+    DoCreate("..", FileHeader::DOTLINK);   // Create a ".." directory
 
     
     // Get the file sector numbers. "." and ".."
@@ -557,7 +599,8 @@ bool FileSystem::CreateDirectory(const char *name) {
 
     delete directory;
 
-    Directory_path("../");
+    DoPath("../");
+    dirLock->ReleaseWrite();
 
     return true;
 }
@@ -580,11 +623,13 @@ void FileSystem::ChangeDirectory(const char* filename)
     if(test == FALSE)
         printf("asd");
    
+    dirLock->AcquireWrite();
     while (name != NULL)
     {
-        test = Directory_path(name);
+        test = DoPath(name);
         name = strtok(NULL, "/");
     }
+    dirLock->ReleaseWrite();
 }
 
  // Function to delete a directory
@@ -593,18 +638,20 @@ void FileSystem:: DeleteDirectory (const char *name)
 
 	Directory *directory;
    
+    dirLock->AcquireWrite();
     directory = new Directory(NumDirEntries);
     directory->FetchFrom(directoryFile);
-    Directory_path((std::string(name) + "/").c_str());
+    DoPath((std::string(name) + "/").c_str());
 
     if (directory->IsEmpty() == false)
     {
-        Directory_path("../");
+        DoPath("../");
         BitMap *freeMap;
         FileHeader *fileHdr;
         int sector;
         sector = directory->Find(name);
         if (sector == -1) {
+            dirLock->ReleaseWrite();
             delete directory;
             printf("cannot rm '%s': No such file or directory\n", name);
             return;
@@ -612,6 +659,7 @@ void FileSystem:: DeleteDirectory (const char *name)
         fileHdr = new FileHeader;
         fileHdr->FetchFrom(sector);
 
+        mapLock->AcquireWrite();
         freeMap = new BitMap(NumSectors);
         freeMap->FetchFrom(freeMapFile);
 
@@ -622,6 +670,7 @@ void FileSystem:: DeleteDirectory (const char *name)
         directory->Remove(name);
 
         freeMap->WriteBack(freeMapFile);        // flush to disk
+        mapLock->ReleaseWrite();
         directory->WriteBack(directoryFile);        // flush to disk
         delete fileHdr;
         delete directory;
@@ -630,6 +679,7 @@ void FileSystem:: DeleteDirectory (const char *name)
     }
     else 
         printf("Can't delete as directory is not empty \n");
+    dirLock->ReleaseWrite();
 
 }
 
@@ -637,3 +687,15 @@ OpenFile* FileSystem::FreeMap()
 {
     return freeMapFile;
 }
+
+RWLock* FileSystem::FreeMapLock()
+{
+    return mapLock;
+}
+
+// Print how often the directory and free map locks made threads wait
+void FileSystem::PrintLocks()
+{
+    dirLock->Print();
+    mapLock->Print();
+}
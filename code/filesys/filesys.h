@@ -42,6 +42,8 @@
 #include "filehdr.h"
 #include <string>
 
+class RWLock;
+
 
 #define FreeMapSector     0
 #define DirectorySector   1
@@ -114,14 +116,26 @@ class FileSystem {
      bool CreateDirectory(const char *name);
      void   ChangeDirectory(const  char* filename); 
      OpenFile *FreeMap();
+     RWLock *FreeMapLock();		// Held for writing by whoever
+					// changes the free map
      void DeleteDirectory (const char *name);
 
+    void PrintLocks();			// Contention of the directory and
+					// free map
 
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   RWLock *dirLock;			// Protects the directories and
+					// directoryFile, taken first
+   RWLock *mapLock;			// Protects the free map
+
+   // The same operations, with dirLock held
+   bool DoCreate(const char* name, FileHeader::FileType type);
+   OpenFile* DoOpen(const char *name);
+   bool DoPath(const char* name);
 
 };
 
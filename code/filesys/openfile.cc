@@ -89,8 +89,10 @@ OpenFile::Write(const char *into, int numBytes)
    {
         int left;
         BitMap *freemap = new BitMap(NumSectors);
+        fileSystem->FreeMapLock()->AcquireWrite();
         freemap->FetchFrom(fileSystem->FreeMap());
         hdr->Deallocate(freemap,seekPosition);
+        fileSystem->FreeMapLock()->ReleaseWrite();
         if (hdr->FileLength() % SectorSize)
         {
              left = SectorSize * (1 + (hdr->FileLength() / SectorSize)) - hdr->FileLength();
@@ -121,6 +123,10 @@ OpenFile::Write(const char *into, int numBytes)
 //	   in the data that will be modified, and write back all the full
 //	   or partial sectors that are part of the request.
 //
+//	When the request is made of whole sectors, as for the pages of a
+//	user program (PageSize == SectorSize), the sectors are transferred
+//	straight from or to the caller's buffer, without any copy.
+//
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
 //	"numBytes" -- the number of bytes to transfer
@@ -142,6 +148,12 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n",     
             numBytes, position, fileLength);
 
+    if (position % SectorSize == 0 && numBytes % SectorSize == 0) {
+        for (i = 0; i < numBytes; i += SectorSize)
+            synchDisk->ReadSector(hdr->ByteToSector(position + i), &into[i]);
+        return numBytes;
+    }
+
 //calculate the starting sector#
     firstSector = divRoundDown(position, SectorSize);
 
@@ -177,16 +189,27 @@ OpenFile::WriteAt(const char *from, int numBytes, int position)
     {
     int extendsize = position + numBytes - fileLength;
         BitMap *freemap = new BitMap(NumSectors);
+        fileSystem->FreeMapLock()->AcquireWrite();
         freemap->FetchFrom(fileSystem->FreeMap());
-        if(hdr->Allocate(freemap,extendsize) == FALSE)
+        if(hdr->Allocate(freemap,extendsize) == FALSE) {
+           fileSystem->FreeMapLock()->ReleaseWrite();
            return 0;
+        }
         hdr->WriteBack(Sector);
         freemap->WriteBack(fileSystem->FreeMap());
+        fileSystem->FreeMapLock()->ReleaseWrite();
         delete freemap;
     }
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n",     
             numBytes, position, fileLength);
 
+    if (position % SectorSize == 0 && numBytes % SectorSize == 0) {
+        for (i = 0; i < numBytes; i += SectorSize)
+            synchDisk->WriteSector(hdr->ByteToSector(position + i),
+                                   (char *) &from[i]);
+        return numBytes;
+    }
+
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
     numSectors = 1 + lastSector - firstSector;
@@ -43,7 +43,9 @@ DiskRequestDone (int arg)
 SynchDisk::SynchDisk(const char* name)
 {
     semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
+    // under -prio, a thread waiting for the disk lends its priority to
+    // the one whose request is in progress
+    lock = new Lock("synch disk lock", TRUE);
     disk = new Disk(name, DiskRequestDone, (int) this);
 }
 
@@ -107,3 +109,14 @@ SynchDisk::RequestDone()
 { 
     semaphore->V();
 }
+
+//----------------------------------------------------------------------
+// SynchDisk::Print
+// 	Print how often threads had to wait for the disk.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Print()
+{
+    lock->Print();
+}
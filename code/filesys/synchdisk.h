@@ -42,6 +42,8 @@ class SynchDisk {
 					// handler, to signal that the
 					// current disk operation is complete.
 
+    void Print();			// Contention of the disk
+
   private:
     Disk *disk;		  		// Raw disk device
     Semaphore *semaphore; 		// To synchronize requesting thread 
@@ -28,7 +28,8 @@
 
 static const char *intLevelNames[] = { "off", "on"};
 static const char *intTypeNames[] = { "timer", "disk", "console write", 
-			"console read", "network send", "network recv"};
+			"console read", "network send", "network recv",
+			"budget timer"};
 
 //----------------------------------------------------------------------
 // PendingInterrupt::PendingInterrupt
@@ -245,6 +246,23 @@ Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
     stats->Print();
+    scheduler->PrintStats();
+    if (DebugIsEnabled('p'))
+	scheduler->PrintThreads();
+#ifdef USER_PROGRAM
+    frameProvider->Print();
+    pageStore->Print();
+    loadControl->Print();
+    vmStats->Print("total");
+    shmTable->Print();
+    futexTable->Print();
+#endif
+#ifdef FILESYS
+    synchDisk->Print();
+    fileSystem->PrintLocks();
+#endif
+    if (synchProfiler != NULL)
+	synchProfiler->Print();
     Cleanup();     // Never returns.
 }
 
@@ -48,9 +48,10 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 
 // IntType records which hardware device generated an interrupt.
 // In Nachos, we support a hardware timer device, a disk, a console
-// display and keyboard, and a network.
+// display and keyboard, and a network.  The budget timer is a one-shot
+// timer of the scheduler, for its real-time class.
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
-				NetworkSendInt, NetworkRecvInt};
+				NetworkSendInt, NetworkRecvInt, BudgetInt};
 
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
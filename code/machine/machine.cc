@@ -58,6 +58,7 @@ Machine::Machine(bool debug)
 
     for (i = 0; i < NumTotalRegs; i++)
         registers[i] = 0;
+    llAddr = -1;
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
@@ -70,6 +71,9 @@ Machine::Machine(bool debug)
     tlb = NULL;
     pageTable = NULL;
 #endif
+    pageDirectory = NULL;
+    pageDirectorySize = 0;
+    FlushTranslationCache();
 
     singleStep = debug;
     CheckEndian();
@@ -104,10 +108,14 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
     
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
+    llAddr = -1;			// a pending SC has to fail
     DelayedLoad(0, 0);			// finish anything in progress
+    // a page fault may also be raised by the kernel, copying from or to
+    // user memory during a system call, which goes on in SystemMode
+    MachineStatus oldStatus = interrupt->getStatus();
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
-    interrupt->setStatus(UserMode);
+    interrupt->setStatus(oldStatus);
 }
 
 //----------------------------------------------------------------------
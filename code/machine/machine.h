@@ -36,6 +36,8 @@
 #define NumPhysPages    1024
 #define MemorySize 	(NumPhysPages * PageSize)
 #define TLBSize		4		// if there is a TLB, make it small
+#define TransCacheSize	16		// entries of the host-side translation
+					// cache (must be a power of 2)
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -144,6 +146,11 @@ class Machine {
 				// Trap to the Nachos kernel, because of a
 				// system call or other exception.  
 
+    void FlushTranslationCache();
+				// Forget the cached translations, must be
+				// called whenever the page table pointers
+				// change or a page table is freed.
+
     void Debugger();		// invoke the user program debugger
     void DumpState();		// print the user CPU and memory state 
 
@@ -157,6 +164,8 @@ class Machine {
     char *mainMemory;		// physical memory to store user program,
 				// code and data, while executing
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
+    int llAddr;			// address linked by the last LL, -1 once
+				// a trap or a context switch broke the link
 
 
 // NOTE: the hardware translation of virtual addresses in the user program
@@ -183,7 +192,22 @@ class Machine {
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
 
+// Instead of the linear page table, the kernel may install a two-level
+// one: "pageDirectory" then holds "pageDirectorySize" pointers to
+// second-level tables (see translate.h).  A NULL second-level table
+// means that none of its pages are mapped.
+
+    TranslationEntry **pageDirectory;
+    unsigned int pageDirectorySize;
+
   private:
+    // Direct-mapped cache of the last page table entries used, indexed
+    // by the low bits of the virtual page number.  It only caches where
+    // the entry lives: the valid and read-only bits are still checked
+    // on every access.
+    unsigned int transCacheVpn[TransCacheSize];
+    TranslationEntry *transCacheEntry[TransCacheSize];
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
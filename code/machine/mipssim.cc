@@ -292,6 +292,21 @@ Machine::OneInstruction(Instruction *instr)
 	nextLoadValue = value;
 	break;
     	
+      case OP_LL:
+	// as LW, and the address is linked until the next trap or
+	// context switch
+	tmp = registers[instr->rs] + instr->extra;
+	if (tmp & 0x3) {
+	    RaiseException(AddressErrorException, tmp);
+	    return;
+	}
+	if (!machine->ReadMem(tmp, 4, &value))
+	    return;
+	llAddr = tmp;
+	nextLoadReg = instr->rt;
+	nextLoadValue = value;
+	break;
+
       case OP_LWL:	  
 	tmp = registers[instr->rs] + instr->extra;
 
@@ -530,6 +545,23 @@ Machine::OneInstruction(Instruction *instr)
 	    return;
 	break;
 	
+      case OP_SC:
+	// only stores if nothing ran since the LL, rt tells whether it did
+	tmp = registers[instr->rs] + instr->extra;
+	if (tmp & 0x3) {
+	    RaiseException(AddressErrorException, tmp);
+	    return;
+	}
+	if (llAddr != tmp) {
+	    registers[instr->rt] = 0;
+	    break;
+	}
+	if (!machine->WriteMem(tmp, 4, registers[instr->rt]))
+	    return;
+	llAddr = -1;
+	registers[instr->rt] = 1;
+	break;
+
       case OP_SWL:	  
 	tmp = registers[instr->rs] + instr->extra;
 
@@ -22,6 +22,7 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPrefetched = numPrefetchHits = numPrefetchWaste = 0;
 }
 
 //----------------------------------------------------------------------
@@ -44,6 +45,9 @@ Statistics::Print()
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
     printf("Paging: faults %d\n", numPageFaults);
+    if (numPrefetched > 0)
+	printf("Prefetch: pages %d, hits %d, wasted %d\n", numPrefetched,
+	       numPrefetchHits, numPrefetchWaste);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
 }
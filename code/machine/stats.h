@@ -43,6 +43,9 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numPrefetched;		// pages loaded ahead of a page fault
+    int numPrefetchHits;	// prefetched pages used afterwards
+    int numPrefetchWaste;	// prefetched pages dropped without use
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
@@ -200,8 +200,9 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     }
     
     // we must have either a TLB or a page table, but not both!
-    ASSERT(tlb == NULL || pageTable == NULL);	
-    ASSERT(tlb != NULL || pageTable != NULL);	
+    ASSERT(tlb == NULL || (pageTable == NULL && pageDirectory == NULL));
+    ASSERT(tlb != NULL || pageTable != NULL || pageDirectory != NULL);
+    ASSERT(pageTable == NULL || pageDirectory == NULL);
 
 // calculate the virtual page number, and offset within the page,
 // from the virtual address
@@ -209,16 +210,35 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     offset = (unsigned) virtAddr % PageSize;
     
     if (tlb == NULL) {		// => page table => vpn is index into table
-	if (vpn >= pageTableSize) {
-	    DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
-			virtAddr, pageTableSize);
-	    return AddressErrorException;
-	} else if (!pageTable[vpn].valid) {
-	    DEBUG('a', "virtual page # %d is not valid!\n",
+	i = vpn & (TransCacheSize - 1);
+	if (transCacheEntry[i] != NULL && transCacheVpn[i] == vpn) {
+	    entry = transCacheEntry[i];		// cached, skip the walk
+	} else if (pageDirectory != NULL) {	// two-level page table
+	    if ((vpn >> PageTableL2Bits) >= pageDirectorySize) {
+		DEBUG('a', "virtual page # %d too large for page directory size %d!\n",
+			vpn, pageDirectorySize);
+		return AddressErrorException;
+	    }
+	    TranslationEntry *table = pageDirectory[vpn >> PageTableL2Bits];
+	    if (table == NULL) {
+		DEBUG('a', "no page table for virtual page # %d!\n", vpn);
+		return PageFaultException;
+	    }
+	    entry = &table[vpn & PageTableL2Mask];
+	} else {
+	    if (vpn >= pageTableSize) {
+		DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
 			virtAddr, pageTableSize);
+		return AddressErrorException;
+	    }
+	    entry = &pageTable[vpn];
+	}
+	transCacheVpn[i] = vpn;
+	transCacheEntry[i] = entry;
+	if (!entry->valid) {
+	    DEBUG('a', "virtual page # %d is not valid!\n", vpn);
 	    return PageFaultException;
 	}
-	entry = &pageTable[vpn];
     } else {
         for (entry = NULL, i = 0; i < TLBSize; i++)
     	    if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
@@ -253,3 +273,17 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
     return NoException;
 }
+
+//----------------------------------------------------------------------
+// Machine::FlushTranslationCache
+// 	Forget all the page table entries cached by Translate.  The cache
+//	holds pointers into the page tables, so it has to be flushed when
+//	switching to another page table, or when one is reallocated or freed.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslationCache()
+{
+    for (int i = 0; i < TransCacheSize; i++)
+	transCacheEntry[i] = NULL;
+}
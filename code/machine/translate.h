@@ -42,4 +42,11 @@ class TranslationEntry {
 			// page is modified.
 };
 
+// Two-level page tables: the high bits of the virtual page number index
+// a page directory, whose entries point to second-level tables of
+// PageTableL2Size entries (or are NULL when nothing is mapped there).
+#define PageTableL2Bits	8
+#define PageTableL2Size	(1 << PageTableL2Bits)
+#define PageTableL2Mask	(PageTableL2Size - 1)
+
 #endif
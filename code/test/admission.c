@@ -0,0 +1,15 @@
+#include "syscall.h"
+
+// Starts more programs than memory can hold at once.  Without paging the
+// extra ones wait in ForkExec for the others to exit, instead of failing;
+// with -vm they all start, and the load control suspends some of them
+// while the others run.
+int main() {
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (ForkExec("../build/vmwork") < 0)
+            PutString("admission: ForkExec failed\n");
+    }
+    return 0;
+}
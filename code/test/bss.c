@@ -0,0 +1,28 @@
+#include "syscall.h"
+
+// 64KB of bss, of which only a few pages are touched: the others are
+// never given a frame.  Then a store into the text, which is read-only.
+#define N 16384
+
+int sparse[N];
+
+int main() {
+    int i;
+
+    for (i = 0; i < N; i += 4096) {
+        if (sparse[i] != 0) {
+            PutString("bss: page not zeroed\n");
+            return 1;
+        }
+        sparse[i] = i;
+    }
+    for (i = 0; i < N; i += 4096) {
+        if (sparse[i] != i) {
+            PutString("bss: wrong value\n");
+            return 1;
+        }
+    }
+    PutString("bss: ok, now writing into the text, expect an error\n");
+    *(int *) main = 0;
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "syscall.h"
+
+// Run it with "-quantum 100 -d p -x cpuaccount": both workers spin for
+// the same number of iterations, the one with the short quantum is
+// switched out more often, the ps-like dump at the exit of the process
+// shows the user, system and wait ticks of each thread, then the exit
+// summary the ones of the whole process.
+#define WORKERS 2
+#define LOOPS 30000
+
+volatile int counts[WORKERS];
+
+void worker(void *arg) {
+    int w = (int) arg;
+    int i;
+
+    if (SetQuantum(w == 0 ? 20 : 400) != 0)
+        PutString("cpuaccount: quantum not inherited\n");
+    for (i = 0; i < LOOPS; i++)
+        counts[w]++;
+    PutString("cpuaccount: worker ");
+    PutInt(w);
+    PutString(" done\n");
+    UserThreadExit();
+}
+
+int main() {
+    void *args[WORKERS];
+    int i, first;
+
+    for (i = 0; i < WORKERS; i++)
+        args[i] = (void *) i;
+    first = UserThreadCreateN(worker, args, WORKERS);
+    if (first < 0) {
+        PutString("cpuaccount: UserThreadCreateN failed\n");
+        return 1;
+    }
+    for (i = 0; i < WORKERS; i++)
+        UserThreadJoin(first + i);
+    if (SetQuantum(-1) != -1)
+        PutString("cpuaccount: negative quantum accepted\n");
+    if (SetQuantum(50) != 0 || SetQuantum(0) != 50)
+        PutString("cpuaccount: SetQuantum does not return the previous quantum\n");
+    PutString("cpuaccount: ok\n");
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "syscall.h"
+
+// Run it with "-rs 1 -x gang", then with "-rs 1 -gang 1000 -x gang":
+// this program spins in 4 threads next to sharehog, a single-threaded
+// process.  With the gang window, the threads of each process run back
+// to back and the "Address space switches" printed at halt drop.
+#define THREADS 4
+#define LOOPS 30000
+
+volatile int counts[THREADS];
+
+void spin(void *arg) {
+    int t = (int) arg;
+    int i;
+
+    for (i = 0; i < LOOPS; i++)
+        counts[t]++;
+    UserThreadExit();
+}
+
+int main() {
+    void *args[THREADS];
+    int i, first;
+
+    if (ForkExec("../build/sharehog") < 0) {
+        PutString("gang: ForkExec failed\n");
+        return 1;
+    }
+    for (i = 0; i < THREADS; i++)
+        args[i] = (void *) i;
+    first = UserThreadCreateN(spin, args, THREADS);
+    if (first < 0) {
+        PutString("gang: UserThreadCreateN failed\n");
+        return 1;
+    }
+    for (i = 0; i < THREADS; i++)
+        UserThreadJoin(first + i);
+    PutString("gang: done\n");
+    return 0;
+}
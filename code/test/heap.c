@@ -0,0 +1,64 @@
+#include "syscall.h"
+#include "malloc.h"
+
+// Builds a linked list and a few large arrays on the heap, frees them
+// and builds them again: the second round reuses the freed blocks.
+#define N 2000
+
+typedef struct node {
+    int value;
+    struct node *next;
+} Node;
+
+static int Round(int round) {
+    Node *list = 0, *n;
+    int *arrays[4];
+    int i, j, sum = 0;
+
+    for (i = 0; i < N; i++) {
+        n = (Node *) malloc(sizeof(Node));
+        if (n == 0) {
+            PutString("heap: out of memory\n");
+            return -1;
+        }
+        n->value = i;
+        n->next = list;
+        list = n;
+    }
+    for (i = 0; i < 4; i++) {
+        arrays[i] = (int *) calloc(1000 * (i + 1), sizeof(int));
+        if (arrays[i] == 0) {
+            PutString("heap: out of memory\n");
+            return -1;
+        }
+        for (j = 0; j < 1000 * (i + 1); j++)
+            arrays[i][j] += j + round;
+    }
+
+    for (n = list; n != 0; n = list) {
+        sum += n->value;
+        list = n->next;
+        free(n);
+    }
+    for (i = 3; i >= 0; i--) {
+        sum += arrays[i][999] - round;
+        free(arrays[i]);
+    }
+    return sum;
+}
+
+int main() {
+    void *start = Sbrk(0);
+    int round;
+
+    for (round = 0; round < 3; round++) {
+        if (Round(round) != N * (N - 1) / 2 + 4 * 999) {
+            PutString("heap: wrong sum\n");
+            return 1;
+        }
+    }
+    PutString("heap: ok, ");
+    PutInt((char *) Sbrk(0) - (char *) start);
+    PutString(" bytes of heap left\n");
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "syscall.h"
+#include "malloc.h"
+
+#define MinShift    4           // smallest class: 16 bytes
+#define NumClasses  8           // largest class: 2048 bytes
+#define LargeClass  NumClasses
+#define ChunkSize   4096        // carved into blocks of a class at once
+#define HeapPage    128         // Sbrk is page granular anyway
+#define TrimSize    (4 * ChunkSize) // unused top of the heap given back
+
+// Put before each block; keeps the payload 8 byte aligned
+typedef struct header {
+    unsigned int cls;           // size class, or LargeClass
+    unsigned int size;          // of the whole block, header included
+} Header;
+
+// A free block, the link is stored in its payload
+typedef struct freeBlock {
+    Header h;
+    struct freeBlock *next;
+} FreeBlock;
+
+static FreeBlock *freeLists[NumClasses + 1];
+static char *top;               // [top, limit) is heap not handed out yet
+static char *limit;
+
+// Takes "size" bytes from the top of the heap, growing it if needed
+static char *Carve(unsigned int size) {
+    char *p;
+
+    if ((unsigned int) (limit - top) < size) {
+        unsigned int grow = (size + ChunkSize - 1) / ChunkSize * ChunkSize;
+        p = (char *) Sbrk(grow);
+        if (p == (char *) -1)
+            return 0;
+        if (p != limit)         // someone else moved the break
+            top = p;
+        limit = p + grow;
+    }
+    p = top;
+    top += size;
+    return p;
+}
+
+// Cuts a chunk into blocks of class "cls", onto its free list
+static int Refill(int cls) {
+    unsigned int size = 1 << (cls + MinShift);
+    char *chunk = Carve(ChunkSize);
+    int i;
+
+    if (chunk == 0)
+        return -1;
+    for (i = ChunkSize / size - 1; i >= 0; i--) {
+        FreeBlock *b = (FreeBlock *) (chunk + i * size);
+        b->h.cls = cls;
+        b->h.size = size;
+        b->next = freeLists[cls];
+        freeLists[cls] = b;
+    }
+    return 0;
+}
+
+void *malloc(unsigned int size) {
+    unsigned int total = size + sizeof(Header);
+    FreeBlock *b, **prev;
+    int cls = 0;
+
+    if (size == 0)
+        return 0;
+    while (cls < NumClasses && (1u << (cls + MinShift)) < total)
+        cls++;
+
+    if (cls < NumClasses) {
+        if (freeLists[cls] == 0 && Refill(cls) < 0)
+            return 0;
+        b = freeLists[cls];
+        freeLists[cls] = b->next;
+        return (char *) b + sizeof(Header);
+    }
+
+    total = (total + HeapPage - 1) / HeapPage * HeapPage;
+    for (prev = &freeLists[LargeClass]; *prev != 0; prev = &(*prev)->next) {
+        if ((*prev)->h.size >= total) {
+            b = *prev;
+            *prev = b->next;
+            return (char *) b + sizeof(Header);
+        }
+    }
+    b = (FreeBlock *) Carve(total);
+    if (b == 0)
+        return 0;
+    b->h.cls = LargeClass;
+    b->h.size = total;
+    return (char *) b + sizeof(Header);
+}
+
+void *calloc(unsigned int n, unsigned int size) {
+    unsigned int i;
+    char *p = (char *) malloc(n * size);
+
+    // the pages fresh from Sbrk are zero, but not the recycled blocks
+    for (i = 0; p != 0 && i < n * size; i++)
+        p[i] = 0;
+    return p;
+}
+
+void free(void *p) {
+    FreeBlock *b;
+
+    if (p == 0)
+        return;
+    b = (FreeBlock *) ((char *) p - sizeof(Header));
+    if (b->h.cls < NumClasses) {
+        b->next = freeLists[b->h.cls];
+        freeLists[b->h.cls] = b;
+        return;
+    }
+
+    // a large block at the top of the heap goes back to it, and the
+    // kernel gets the pages back once enough of them are unused
+    if ((char *) b + b->h.size == top) {
+        top = (char *) b;
+        if (limit - top >= TrimSize) {
+            unsigned int excess = (limit - top) / ChunkSize * ChunkSize;
+            if (Sbrk(-excess) == limit)
+                limit -= excess;
+        }
+        return;
+    }
+    b->next = freeLists[LargeClass];
+    freeLists[LargeClass] = b;
+}
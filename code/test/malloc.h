@@ -0,0 +1,16 @@
+#ifndef MALLOC_H
+#define MALLOC_H
+
+// Memory allocator of the user programs, on top of Sbrk.  Link a program
+// with it by adding malloc.c to its _EXTRA_SOURCES in Makefile.define-user.
+//
+// Small blocks come from one free list per size class (powers of two,
+// 16 to 2048 bytes with the header), filled a chunk at a time; larger
+// ones are whole pages, kept on a first fit list once freed.  It is not
+// safe to use from several threads at once.
+
+void *malloc(unsigned int size);
+void *calloc(unsigned int n, unsigned int size);
+void free(void *p);
+
+#endif // MALLOC_H
@@ -0,0 +1,42 @@
+#include "syscall.h"
+
+// Creates and joins far more threads than fit at once, in batches:
+// their stacks are recycled, and their ids keep growing.
+#define BATCH 50
+#define ROUNDS 60
+
+int results[BATCH];
+
+void worker(void *arg) {
+    int i = (int) arg;
+    results[i] += i;
+    UserThreadExit();
+}
+
+int main() {
+    int tids[BATCH];
+    int round, i, last = 0;
+
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = 0; i < BATCH; i++) {
+            tids[i] = UserThreadCreate(worker, (void *) i);
+            if (tids[i] <= last) {
+                PutString("manythreads: bad thread id\n");
+                return 1;
+            }
+            last = tids[i];
+        }
+        for (i = 0; i < BATCH; i++)
+            UserThreadJoin(tids[i]);
+    }
+    for (i = 0; i < BATCH; i++) {
+        if (results[i] != i * ROUNDS) {
+            PutString("manythreads: wrong result\n");
+            return 1;
+        }
+    }
+    PutString("manythreads: ok, ");
+    PutInt(last);
+    PutString(" threads\n");
+    return 0;
+}
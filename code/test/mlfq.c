@@ -0,0 +1,48 @@
+#include "syscall.h"
+
+// CPU-bound threads next to a console-bound one.  Run it with
+// "-mlfq 3 -x mlfq" then without -mlfq: under MLFQ the hogs sink to the
+// bottom level and the printer, which blocks on each line, stays on top
+// and finishes long before them (compare the scheduler statistics).
+#define HOGS 3
+#define LOOPS 200000
+
+volatile int counts[HOGS];
+
+void hog(void *arg) {
+    int h = (int) arg;
+    int i;
+
+    for (i = 0; i < LOOPS; i++)
+        counts[h]++;
+    PutString("mlfq: hog done\n");
+    UserThreadExit();
+}
+
+void printer(void *arg) {
+    int i;
+
+    for (i = 0; i < 10; i++)
+        PutString("mlfq: printer line\n");
+    PutString("mlfq: printer done\n");
+    UserThreadExit();
+}
+
+int main() {
+    void *args[HOGS];
+    int i, first, tid;
+
+    for (i = 0; i < HOGS; i++)
+        args[i] = (void *) i;
+    first = UserThreadCreateN(hog, args, HOGS);
+    tid = UserThreadCreate(printer, 0);
+    if (first < 0 || tid < 0) {
+        PutString("mlfq: cannot create threads\n");
+        return 1;
+    }
+    UserThreadJoin(tid);
+    for (i = 0; i < HOGS; i++)
+        UserThreadJoin(first + i);
+    PutString("mlfq: ok\n");
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "syscall.h"
+
+// Fills a file through a mapping, then maps it again to check that the
+// bytes written the first time were saved to the file
+#define SIZE 1000
+
+int main() {
+    OpenFileId f;
+    char *p;
+    int i;
+
+    Create("mmapfile");
+    f = Open("mmapfile");
+    if (f < 0) {
+        PutString("Unable to open mmapfile\n");
+        return 1;
+    }
+
+    p = (char *) Mmap(f, 0, SIZE);
+    for (i = 0; i < SIZE; i++)
+        p[i] = 'a' + i % 26;
+    Munmap(p);
+
+    p = (char *) Mmap(f, 0, SIZE);
+    for (i = 0; i < SIZE; i++) {
+        if (p[i] != 'a' + i % 26) {
+            PutString("Wrong byte at ");
+            PutInt(i);
+            PutChar('\n');
+            return 1;
+        }
+    }
+    PutString(p + SIZE - 26);
+    PutChar('\n');
+    Munmap(p);
+    Close(f);
+    return 0;
+}
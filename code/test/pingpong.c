@@ -0,0 +1,45 @@
+#include "syscall.h"
+
+// Yield ping-pong between two threads of a process: run it with
+// "-x pingpong" and compare the "Context switches" printed at halt with
+// the user registers loaded and the address space switches.  The page
+// table is only loaded once, the threads sharing it.
+#define ROUNDS 1000
+
+volatile int pings, pongs;
+
+void pong(void *arg) {
+    int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        pongs++;
+        Yield();
+    }
+    UserThreadExit();
+}
+
+int main() {
+    void *args[1];
+    int i, first, lag = 0;
+
+    args[0] = (void *) 0;
+    first = UserThreadCreateN(pong, args, 1);
+    if (first < 0) {
+        PutString("pingpong: UserThreadCreateN failed\n");
+        return 1;
+    }
+    for (i = 0; i < ROUNDS; i++) {
+        pings++;
+        Yield();
+        if (pings - pongs > 1)
+            lag++;
+    }
+    UserThreadJoin(first);
+    if (lag > 0) {
+        PutString("pingpong: threads did not alternate ");
+        PutInt(lag);
+        PutString(" times\n");
+    }
+    PutString("pingpong: done\n");
+    return 0;
+}
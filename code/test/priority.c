@@ -0,0 +1,45 @@
+#include "syscall.h"
+
+// Run it with "-prio -x priority": the workers are given priorities in
+// the opposite order of their creation, they must finish in priority
+// order, highest first.
+#define WORKERS 3
+#define LOOPS 20000
+
+volatile int counts[WORKERS];
+
+void worker(void *arg) {
+    int w = (int) arg;
+    int i;
+
+    for (i = 0; i < LOOPS; i++)
+        counts[w]++;
+    PutString("priority: worker ");
+    PutInt(w);
+    PutString(" done\n");
+    UserThreadExit();
+}
+
+int main() {
+    void *args[WORKERS];
+    int i, first;
+
+    // stay above the workers until they are all set up
+    SetPriority(0, 10);
+    for (i = 0; i < WORKERS; i++)
+        args[i] = (void *) i;
+    first = UserThreadCreateN(worker, args, WORKERS);
+    if (first < 0) {
+        PutString("priority: UserThreadCreateN failed\n");
+        return 1;
+    }
+    for (i = 0; i < WORKERS; i++)
+        SetPriority(first + i, 40 - 10 * i);   // 2, 1 then 0 expected
+
+    for (i = 0; i < WORKERS; i++)
+        UserThreadJoin(first + i);
+    if (SetPriority(0, 64) != -1)
+        PutString("priority: out of range priority accepted\n");
+    PutString("priority: ok\n");
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "syscall.h"
+
+// A real-time thread with 300 ticks every 1000 next to a batch one.  The
+// real-time thread runs first in each period, then is throttled until
+// the next one, so the batch thread still progresses.  A second thread
+// asking for 70% of the CPU must be refused.  Compare the real-time
+// statistics printed at halt.
+#define LOOPS 100000
+
+volatile int rtCount, batchCount;
+volatile int refused;
+
+void rt(void *arg) {
+    int i;
+
+    if (SetRealTime(300, 1000) < 0) {
+        PutString("realtime: not admitted\n");
+        UserThreadExit();
+    }
+    for (i = 0; i < LOOPS; i++)
+        rtCount++;
+    SetRealTime(0, 0);
+    PutString("realtime: rt done\n");
+    UserThreadExit();
+}
+
+void greedy(void *arg) {
+    refused = (SetRealTime(700, 1000) < 0);
+    UserThreadExit();
+}
+
+void batch(void *arg) {
+    int i;
+
+    for (i = 0; i < LOOPS; i++)
+        batchCount++;
+    PutString("realtime: batch done\n");
+    UserThreadExit();
+}
+
+int main() {
+    int rtTid, batchTid, greedyTid;
+
+    // queued in this order: the real-time thread is admitted first
+    rtTid = UserThreadCreate(rt, 0);
+    batchTid = UserThreadCreate(batch, 0);
+    greedyTid = UserThreadCreate(greedy, 0);
+    if (rtTid < 0 || batchTid < 0 || greedyTid < 0) {
+        PutString("realtime: cannot create threads\n");
+        return 1;
+    }
+    UserThreadJoin(greedyTid);
+    UserThreadJoin(batchTid);
+    UserThreadJoin(rtTid);
+    if (!refused)
+        PutString("realtime: admission control let 100% through\n");
+    PutString("realtime: ok\n");
+    return 0;
+}
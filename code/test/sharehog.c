@@ -0,0 +1,18 @@
+#include "syscall.h"
+
+// A single thread with three times the default tickets, started by
+// shares.c
+#define LOOPS 120000
+
+volatile int count;
+
+int main() {
+    int i;
+
+    if (SetTickets(300) != 100)
+        PutString("sharehog: wrong previous tickets\n");
+    for (i = 0; i < LOOPS; i++)
+        count++;
+    PutString("sharehog: done\n");
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "syscall.h"
+
+// Run it with "-stride -d S -x shares" (or -lottery): this program spins
+// in 4 threads with 100 tickets, sharehog in a single one with 300.  The
+// shares printed should be close to 25% and 75%, whatever the number of
+// threads of each.
+#define THREADS 4
+#define LOOPS 30000
+
+volatile int counts[THREADS];
+
+void spin(void *arg) {
+    int t = (int) arg;
+    int i;
+
+    for (i = 0; i < LOOPS; i++)
+        counts[t]++;
+    UserThreadExit();
+}
+
+int main() {
+    void *args[THREADS];
+    int i, first;
+
+    if (ForkExec("../build/sharehog") < 0) {
+        PutString("shares: ForkExec failed\n");
+        return 1;
+    }
+    for (i = 0; i < THREADS; i++)
+        args[i] = (void *) i;
+    first = UserThreadCreateN(spin, args, THREADS);
+    if (first < 0) {
+        PutString("shares: UserThreadCreateN failed\n");
+        return 1;
+    }
+    for (i = 0; i < THREADS; i++)
+        UserThreadJoin(first + i);
+    PutString("shares: done\n");
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include "syscall.h"
+
+// Fills a shared segment, then starts shmreader which adds it up and
+// posts the sum back through the same segment.  Run with -rs, so that
+// the wait below is preempted.
+#define KEY 42
+#define N 1000
+
+int main() {
+    volatile int *shared = (volatile int *) ShmCreate(KEY, (N + 2) * sizeof(int));
+    int i;
+
+    if (shared == (int *) -1) {
+        PutString("shm: ShmCreate failed\n");
+        return 1;
+    }
+    for (i = 0; i < N; i++)
+        shared[i + 2] = i;
+    shared[0] = 1;              // data ready
+
+    if (ForkExec("../build/shmreader") < 0) {
+        PutString("shm: ForkExec failed\n");
+        return 1;
+    }
+    while (shared[0] != 2)      // sum posted
+        ;
+    if (shared[1] == N * (N - 1) / 2)
+        PutString("shm: ok\n");
+    else
+        PutString("shm: wrong sum\n");
+    ShmDetach((void *) shared);
+    return 0;
+}
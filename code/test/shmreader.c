@@ -0,0 +1,22 @@
+#include "syscall.h"
+
+// Reads the segment filled by shm.c
+#define KEY 42
+#define N 1000
+
+int main() {
+    volatile int *shared = (volatile int *) ShmAttach(KEY);
+    int i, sum = 0;
+
+    if (shared == (int *) -1) {
+        PutString("shmreader: ShmAttach failed\n");
+        return 1;
+    }
+    while (shared[0] != 1)
+        ;
+    for (i = 0; i < N; i++)
+        sum += shared[i + 2];
+    shared[1] = sum;
+    shared[0] = 2;
+    return 0;
+}
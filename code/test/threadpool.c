@@ -0,0 +1,45 @@
+#include "syscall.h"
+
+// Starts a pool of workers with a single system call, each one summing
+// its own slice of an array
+#define WORKERS 16
+#define N 4096
+
+int data[N];
+int sums[WORKERS];
+
+void worker(void *arg) {
+    int w = (int) arg;
+    int i, sum = 0;
+
+    for (i = w * (N / WORKERS); i < (w + 1) * (N / WORKERS); i++)
+        sum += data[i];
+    sums[w] = sum;
+    UserThreadExit();
+}
+
+int main() {
+    void *args[WORKERS];
+    int i, first, total = 0;
+
+    for (i = 0; i < N; i++)
+        data[i] = i;
+    for (i = 0; i < WORKERS; i++)
+        args[i] = (void *) i;
+
+    first = UserThreadCreateN(worker, args, WORKERS);
+    if (first < 0) {
+        PutString("threadpool: UserThreadCreateN failed\n");
+        return 1;
+    }
+    for (i = 0; i < WORKERS; i++)
+        UserThreadJoin(first + i);
+    for (i = 0; i < WORKERS; i++)
+        total += sums[i];
+
+    if (total == N * (N - 1) / 2)
+        PutString("threadpool: ok\n");
+    else
+        PutString("threadpool: wrong sum\n");
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "syscall.h"
+#include "usync.h"
+
+#define WakeAll 0x7fffffff
+
+// The simulated MIPS is a MIPS I, the assembler has to be told about
+// LL and SC; the NOP after LL covers its load delay slot
+int AtomicAdd(int *p, int n) {
+    int old, tmp;
+
+    __asm__ volatile (
+        ".set push\n\t.set mips2\n\t.set noreorder\n"
+        "1:\tll\t%0, 0(%2)\n\t"
+        "nop\n\t"
+        "addu\t%1, %0, %3\n\t"
+        "sc\t%1, 0(%2)\n\t"
+        "beqz\t%1, 1b\n\t"
+        "nop\n\t"
+        ".set pop"
+        : "=&r" (old), "=&r" (tmp)
+        : "r" (p), "r" (n)
+        : "memory");
+    return old;
+}
+
+int CompareAndSwap(int *p, int old, int new) {
+    int prev, tmp;
+
+    __asm__ volatile (
+        ".set push\n\t.set mips2\n\t.set noreorder\n"
+        "1:\tll\t%0, 0(%2)\n\t"
+        "nop\n\t"
+        "bne\t%0, %3, 2f\n\t"
+        "move\t%1, %4\n\t"
+        "sc\t%1, 0(%2)\n\t"
+        "beqz\t%1, 1b\n\t"
+        "nop\n"
+        "2:\n\t"
+        ".set pop"
+        : "=&r" (prev), "=&r" (tmp)
+        : "r" (p), "r" (old), "r" (new)
+        : "memory");
+    return prev;
+}
+
+static int Swap(int *p, int new) {
+    int old;
+
+    do {
+        old = *(volatile int *) p;
+    } while (CompareAndSwap(p, old, new) != old);
+    return old;
+}
+
+// As in Drepper's "Futexes are tricky": a thread which finds the mutex
+// taken marks it 2 before sleeping, so that the owner only calls the
+// kernel on unlock when someone may be waiting
+static void LockContended(Mutex *m) {
+    while (Swap(&m->state, 2) != 0)
+        FutexWait(&m->state, 2);
+}
+
+void MutexLock(Mutex *m) {
+    if (CompareAndSwap(&m->state, 0, 1) != 0)
+        LockContended(m);
+}
+
+int MutexTryLock(Mutex *m) {
+    return CompareAndSwap(&m->state, 0, 1) == 0 ? 0 : -1;
+}
+
+void MutexUnlock(Mutex *m) {
+    if (AtomicAdd(&m->state, -1) != 1) {
+        m->state = 0;
+        FutexWake(&m->state, 1);
+    }
+}
+
+void CondWait(Cond *c, Mutex *m) {
+    int seq = c->seq;
+
+    MutexUnlock(m);
+    FutexWait(&c->seq, seq);
+    // the other threads woken up may want the mutex too
+    LockContended(m);
+}
+
+void CondSignal(Cond *c) {
+    AtomicAdd(&c->seq, 1);
+    FutexWake(&c->seq, 1);
+}
+
+void CondBroadcast(Cond *c) {
+    AtomicAdd(&c->seq, 1);
+    FutexWake(&c->seq, WakeAll);
+}
+
+int BarrierWait(Barrier *b, int n) {
+    int generation;
+
+    MutexLock(&b->lock);
+    generation = b->generation;
+    if (++b->count == n) {
+        b->count = 0;
+        AtomicAdd(&b->generation, 1);
+        MutexUnlock(&b->lock);
+        FutexWake(&b->generation, WakeAll);
+        return 1;
+    }
+    MutexUnlock(&b->lock);
+    while (*(volatile int *) &b->generation == generation)
+        FutexWait(&b->generation, generation);
+    return 0;
+}
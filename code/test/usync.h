@@ -0,0 +1,42 @@
+#ifndef USYNC_H
+#define USYNC_H
+
+// Synchronization between the threads of a user program, or between
+// programs through shared memory.  Taking a free mutex, or signaling a
+// condition nobody waits for, stays in user mode: the kernel is only
+// called, through FutexWait/FutexWake, when a thread has to sleep or to
+// be woken up.  Link a program with it by adding usync.c to its
+// _EXTRA_SOURCES in Makefile.define-user.  All the structures start
+// zeroed, which is their initial state.
+
+typedef struct {
+    int state;          // 0 free, 1 taken, 2 taken and maybe waited for
+} Mutex;
+
+typedef struct {
+    int seq;            // bumped by each signal
+} Cond;
+
+typedef struct {
+    Mutex lock;
+    int count;          // threads arrived in this generation
+    int generation;
+} Barrier;
+
+// Atomic operations, with LL/SC; both return the previous value
+int AtomicAdd(int *p, int n);
+int CompareAndSwap(int *p, int old, int new);
+
+void MutexLock(Mutex *m);
+int MutexTryLock(Mutex *m);     // 0 if taken, -1 if busy
+void MutexUnlock(Mutex *m);
+
+void CondWait(Cond *c, Mutex *m);
+void CondSignal(Cond *c);
+void CondBroadcast(Cond *c);
+
+// Blocks until "n" threads called it, returns 1 in one of them, 0 in
+// the others
+int BarrierWait(Barrier *b, int n);
+
+#endif // USYNC_H
@@ -0,0 +1,64 @@
+#include "syscall.h"
+#include "usync.h"
+
+// Threads incrementing a counter under a mutex, meeting at a barrier,
+// then a producer and consumers on a condition.  Run with -rs, so that
+// the threads are preempted while holding the mutex.
+#define THREADS 4
+#define LOOPS 500
+
+Mutex mutex;
+Cond nonEmpty;
+Barrier barrier;
+int counter;
+int items;
+int consumed;
+
+void worker(void *arg) {
+    int i;
+
+    for (i = 0; i < LOOPS; i++) {
+        MutexLock(&mutex);
+        counter++;
+        MutexUnlock(&mutex);
+    }
+    BarrierWait(&barrier, THREADS);
+
+    // each worker consumes LOOPS items
+    for (i = 0; i < LOOPS; i++) {
+        MutexLock(&mutex);
+        while (items == 0)
+            CondWait(&nonEmpty, &mutex);
+        items--;
+        consumed++;
+        MutexUnlock(&mutex);
+    }
+    UserThreadExit();
+}
+
+int main() {
+    void *args[THREADS];
+    int i, first;
+
+    for (i = 0; i < THREADS; i++)
+        args[i] = 0;
+    first = UserThreadCreateN(worker, args, THREADS);
+    if (first < 0) {
+        PutString("usynctest: UserThreadCreateN failed\n");
+        return 1;
+    }
+    for (i = 0; i < THREADS * LOOPS; i++) {
+        MutexLock(&mutex);
+        items++;
+        CondSignal(&nonEmpty);
+        MutexUnlock(&mutex);
+    }
+    for (i = 0; i < THREADS; i++)
+        UserThreadJoin(first + i);
+
+    if (counter == THREADS * LOOPS && consumed == THREADS * LOOPS)
+        PutString("usynctest: ok\n");
+    else
+        PutString("usynctest: wrong count\n");
+    return 0;
+}
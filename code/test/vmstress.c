@@ -0,0 +1,10 @@
+#include "syscall.h"
+
+// Runs two programs which need more frames than the machine has, which
+// only works with page eviction (-vm):
+//      ./nachos-step2 -vm -x ../build/vmstress
+int main() {
+    ForkExec("../build/vmwork");
+    ForkExec("../build/vmwork");
+    return 0;
+}
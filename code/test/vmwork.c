@@ -0,0 +1,26 @@
+#include "syscall.h"
+
+// 80KB of data: two of these do not fit in physical memory together,
+// see vmstress.c
+#define N 20000
+
+int data[N];
+
+int main() {
+    int i, pass;
+
+    for (pass = 0; pass < 3; pass++) {
+        for (i = 0; i < N; i++)
+            data[i] = i * pass;
+        for (i = 0; i < N; i++) {
+            if (data[i] != i * pass) {
+                PutString("vmwork: wrong value at ");
+                PutInt(i);
+                PutChar('\n');
+                return 1;
+            }
+        }
+    }
+    PutString("vmwork: ok\n");
+    return 0;
+}
@@ -9,21 +9,58 @@
 //      Most of this file is not needed until later assignments.
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
-//              -s -x <nachos file> -c <consoleIn> <consoleOut>
+//              -mlfq <levels> -prio -stride -lottery -quantum <ticks>
+//              -gang <ticks> -lp <n>
+//              -s -x <nachos file> -c <consoleIn> <consoleOut> -rp
+//              -ml <max frames per process> -spt -lpt
+//              -fa <pages> -pf <pages> -vm -zp <bytes>
 //              -f -cp <unix file> <nachos file>
 //              -p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
 //              -z
 //
-//    -d causes certain debugging messages to be printed (cf. utility.h)
+//    -d causes certain debugging messages to be printed (cf. utility.h),
+//       with 'v' the VM telemetry of each process is printed when it exits,
+//       with 'S' the CPU share each process asked for and got, whenever
+//       the processes or their tickets change (-stride and -lottery),
+//       with 'p' the threads and the CPU time they used, whenever a
+//       process exits and at halt
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -mlfq schedules threads with a multi-level feedback queue of that
+//        many levels (at most 8) instead of FIFO
+//    -prio schedules threads by fixed priority (SetPriority), 0 to 63
+//    -stride and -lottery divide the CPU between processes in proportion
+//        to their tickets (SetTickets), whatever their number of threads
+//    -quantum sets the MLFQ quantum of the top level (default 100
+//        ticks), each level below gets twice the one above; with the
+//        other policies, the time slice of the threads.  Without it,
+//        FIFO switches threads at each timer interrupt.  A thread can
+//        set its own quantum (SetQuantum)
+//    -gang runs the ready threads of the process which has the CPU
+//        first, as long as it has not held it for that many ticks
+//    -lp profiles the semaphores and locks, and prints at halt the n
+//        names which made threads wait longest
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
 //    -x runs a user program
 //    -c tests the console
+//    -rp places user pages in random physical frames
+//    -ml limits the number of physical frames of each user process
+//    -spt uses two-level (sparse) page tables for user programs, the
+//        default since the stacks of the threads are at the top of the
+//        address space
+//    -lpt uses a linear page table instead, which grows to cover the
+//        highest page used
+//    -fa loads the aligned block of that many pages around a page
+//        fault on a mapped file (default 4, 0 or 1 disables it)
+//    -pf bounds the read-ahead window on sequential page faults
+//        (default 16, 0 disables it)
+//    -vm evicts pages when physical memory is full, instead of failing
+//    -zp sets the size of the pool of compressed evicted pages (default
+//        32768 bytes, 0 sends them all to the swap file)
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
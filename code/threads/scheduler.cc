@@ -11,8 +11,28 @@
 //      end up calling FindNextToRun(), and that would put us in an 
 //      infinite loop.
 //
-//      Very simple implementation -- no priorities, straight FIFO.
-//      Might need to be improved in later assignments.
+//      Five policies: straight FIFO, a multi-level feedback queue, fixed
+//      priorities, and the STRIDE and LOTTERY proportional shares
+//      described below.  MLFQ and PRIORITY pick the first thread of the
+//      highest non-empty level.  Under MLFQ, a thread which uses up its
+//      quantum moves one level down; a thread which gives up the CPU
+//      (yields or blocks) before half its quantum moves one level up.
+//      Every BoostQuanta bottom-level quanta, all threads go back to the
+//      top level so that none starves.  Under PRIORITY, the level of a
+//      thread is its priority, and only SetPriority changes it; nothing
+//      prevents starvation.
+//
+//      STRIDE and LOTTERY first choose a share group (a process), then
+//      run its ready threads in turn.  STRIDE chooses the group with the
+//      lowest pass, the CPU time it used divided by its tickets; a group
+//      which had no ready thread cannot claim the time it did not use.
+//      LOTTERY draws one of the tickets of the groups with ready threads.
+//
+//      Real-time threads come before all of them, earliest deadline
+//      first.  The budget interrupt is set for the moment the running
+//      one uses up its budget, or the next period of one of them starts;
+//      it is not cancelled when plans change, BudgetExpired just finds
+//      nothing to do then.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -22,30 +42,218 @@
 #include "scheduler.h"
 #include "system.h"
 
+#include <strings.h>
+
+// Dummy function because C++ does not allow pointers to member functions
+static void
+BudgetHandler (int arg)
+{
+    Scheduler *s = (Scheduler *) arg;
+    s->BudgetExpired ();
+}
+
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
-//      Initialize the list of ready but not running threads to empty.
+//      Initialize the lists of ready but not running threads to empty.
+//
+//      "policy" is one of the SchedPolicy.
+//      "levels" is the number of MLFQ priority levels.
+//      "quantum" is the quantum of the top level, in ticks, 0 for the
+//              default: TimerTicks, and under FIFO, a switch at every
+//              timer interrupt, whenever it comes.
+//      "gang" is the gang window, in ticks, 0 to disable it.
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler ()
+Scheduler::Scheduler (SchedPolicy schedPolicy, int levels, int topQuantum,
+		      int gang)
+:kernelGroup (0)
 {
-    readyList = new List;
+    policy = schedPolicy;
+    if (policy == POLICY_MLFQ)
+	numLevels = levels;
+    else if (policy == POLICY_PRIORITY)
+	numLevels = NumPriorities;
+    else
+	numLevels = 1;
+    ASSERT (numLevels >= 1 && numLevels <= MaxSchedLevels);
+    ASSERT (policy != POLICY_MLFQ || numLevels <= MaxMlfqLevels);
+    ASSERT (topQuantum >= 0);
+    everyTick = (topQuantum == 0);
+    if (topQuantum == 0)
+	topQuantum = TimerTicks;
+    for (int i = 0; i < numLevels; i++)
+      {
+	  ready[i].head = ready[i].tail = NULL;
+	  quantum[i] = (policy == POLICY_MLFQ) ? topQuantum << i : topQuantum;
+	  numReady[i] = 0;
+	  maxReady[i] = 0;
+	  sumReady[i] = 0;
+	  numQueued[i] = 0;
+	  numDispatches[i] = 0;
+	  ticksRun[i] = 0;
+      }
+    for (int i = 0; i < ReadyMaskWords; i++)
+	readyMask[i] = 0;
+    boostInterval = (long long) BoostQuanta *quantum[numLevels - 1];
+    lastBoost = 0;
+    epoch = 0;
+    numPromotions = 0;
+    numDemotions = 0;
+    groups = &kernelGroup;
+    virtualTime = 0;
+    periodStart = 0;
+    rtReady.head = rtReady.tail = NULL;
+    rtThrottled.head = rtThrottled.tail = NULL;
+    rtUtilization = 0;
+    rtArmedAt = -1;
+    rtAdmitted = rtRejected = 0;
+    rtPeriods = rtMisses = rtOverruns = 0;
+    rtTicks = 0;
+    allThreads = NULL;
+    ASSERT (gang >= 0);
+    gangWindow = gang;
+    lastSpace = -1;
+    spaceSince = 0;
+    regsOwner = NULL;
+    numSwitches = 0;
+    numRegSaves = 0;
+    numRegLoads = 0;
+    numSpaceSwitches = 0;
+    numGangPicks = 0;
+}
+
+//----------------------------------------------------------------------
+// ShareGroup::ShareGroup
+//      Initialize a share group with the default tickets, and no thread
+//      ready.
+//----------------------------------------------------------------------
+
+ShareGroup::ShareGroup (int groupId)
+{
+    id = groupId;
+    tickets = DefaultTickets;
+    pass = 0;
+    ready.head = ready.tail = NULL;
+    numReady = 0;
+    ticksRun = 0;
+    next = NULL;
 }
 
 //----------------------------------------------------------------------
 // Scheduler::~Scheduler
-//      De-allocate the list of ready threads.
+//      De-allocate the lists of ready threads: nothing to do, they are
+//      linked through the threads.
 //----------------------------------------------------------------------
 
 Scheduler::~Scheduler ()
 {
-    delete readyList;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::GroupOf, Scheduler::QueueOf
+//      Return the share group of a thread: the one of its address
+//      space, or the kernel one.  Return the ready list a thread goes
+//      on: the one of its level, or under STRIDE and LOTTERY, the one
+//      of its group.
+//----------------------------------------------------------------------
+
+ShareGroup *
+Scheduler::GroupOf (Thread * thread)
+{
+#ifdef USER_PROGRAM
+    if (thread->space != NULL)
+	return thread->space->Share ();
+#endif
+    return &kernelGroup;
+}
+
+ReadyQueue *
+Scheduler::QueueOf (Thread * thread)
+{
+    if (policy == POLICY_STRIDE || policy == POLICY_LOTTERY)
+	return &GroupOf (thread)->ready;
+    return &ready[thread->level];
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Enqueue, Scheduler::Unlink
+//      Append a thread to its ready list, or take it off that list,
+//      keeping the bitmap of non-empty levels up to date.
+//
+//      Under STRIDE, a group which gets a ready thread again after a
+//      while starts from the pass of the last group chosen, rather than
+//      from the one it had when it stopped.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Enqueue (Thread * thread)
+{
+    ReadyQueue *queue = QueueOf (thread);
+    int l = thread->level;
+
+    thread->readyNext = NULL;
+    thread->readyPrev = queue->tail;
+    if (queue->tail == NULL)
+	queue->head = thread;
+    else
+	queue->tail->readyNext = thread;
+    queue->tail = thread;
+    if (policy == POLICY_STRIDE || policy == POLICY_LOTTERY)
+      {
+	  ShareGroup *group = GroupOf (thread);
+
+	  if (group->numReady++ == 0 && group != GroupOf (currentThread)
+	      && group->pass < virtualTime)
+	      group->pass = virtualTime;
+      }
+    if (numReady[l]++ == 0)
+	readyMask[l / 32] |= 1U << (l % 32);
+    if (numReady[l] > maxReady[l])
+	maxReady[l] = numReady[l];
+}
+
+void
+Scheduler::Unlink (Thread * thread)
+{
+    ReadyQueue *queue = QueueOf (thread);
+    int l = thread->level;
+
+    if (thread->readyPrev == NULL)
+	queue->head = thread->readyNext;
+    else
+	thread->readyPrev->readyNext = thread->readyNext;
+    if (thread->readyNext == NULL)
+	queue->tail = thread->readyPrev;
+    else
+	thread->readyNext->readyPrev = thread->readyPrev;
+    thread->readyNext = thread->readyPrev = NULL;
+    if (policy == POLICY_STRIDE || policy == POLICY_LOTTERY)
+	GroupOf (thread)->numReady--;
+    if (--numReady[l] == 0)
+	readyMask[l / 32] &= ~(1U << (l % 32));
+}
+
+//----------------------------------------------------------------------
+// Scheduler::HighestReady
+//      Return the highest priority level with a ready thread, -1 if
+//      there is none.
+//----------------------------------------------------------------------
+
+int
+Scheduler::HighestReady ()
+{
+    for (int i = 0; i < ReadyMaskWords; i++)
+	if (readyMask[i] != 0)
+	    return i * 32 + ffs ((int) readyMask[i]) - 1;
+    return -1;
 }
 
 //----------------------------------------------------------------------
 // Scheduler::ReadyToRun
 //      Mark a thread as ready, but not running.
-//      Put it on the ready list, for later scheduling onto the CPU.
+//      Put it on the ready list of its level, for later scheduling onto
+//      the CPU.  A thread which missed a priority boost while it was
+//      blocked gets it now.
 //
 //      "thread" is the thread to be put on the ready list.
 //----------------------------------------------------------------------
@@ -55,13 +263,32 @@ Scheduler::ReadyToRun (Thread * thread)
 {
     DEBUG ('t', "Putting thread %s on ready list.\n", thread->getName ());
 
+    if (thread == currentThread)
+	Charge (thread);	// it is yielding the CPU
+    thread->readySince = stats->totalTicks;
+    if (thread->rtPeriod > 0)
+      {
+	  RtReady (thread);
+	  return;
+      }
+    if (policy == POLICY_PRIORITY)
+	thread->level = thread->priority;
+    else if (thread->epoch != epoch)
+      {
+	  thread->level = 0;
+	  thread->epoch = epoch;
+      }
     thread->setStatus (READY);
-    readyList->Append ((void *) thread);
+    Enqueue (thread);
+    sumReady[thread->level] += numReady[thread->level] - 1;
+    numQueued[thread->level]++;
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
-//      Return the next thread to be scheduled onto the CPU.
+//      Return the next thread to be scheduled onto the CPU: the ready
+//      real-time thread with the earliest deadline, else the first one
+//      of the highest priority level which is not empty.
 //      If there are no ready threads, return NULL.
 // Side effect:
 //      Thread is removed from the ready list.
@@ -70,7 +297,321 @@ Scheduler::ReadyToRun (Thread * thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *) readyList->Remove ();
+    Thread *thread;
+    int l;
+
+    if (currentThread->getStatus () == BLOCKED)
+	Charge (currentThread);	// before we idle, if nobody is ready
+    if (policy == POLICY_MLFQ
+	&& stats->totalTicks - lastBoost >= boostInterval)
+	Boost ();
+
+    if (rtReady.head != NULL)
+      {
+	  thread = rtReady.head;
+	  RtRemove (&rtReady, thread);
+	  return thread;
+      }
+
+    if (policy == POLICY_STRIDE || policy == POLICY_LOTTERY)
+      {
+	  ShareGroup *group = PickGroup ();
+
+	  if (group == NULL)
+	      return NULL;
+	  thread = group->ready.head;
+	  l = 0;
+      }
+    else
+      {
+	  if ((l = HighestReady ()) < 0)
+	      return NULL;
+	  thread = ready[l].head;
+	  if (GangOpen () && SpaceOf (thread) != lastSpace)
+	    {
+		Thread *member = GangMember (&ready[l]);
+
+		if (member != NULL)
+		  {
+		      thread = member;
+		      numGangPicks++;
+		  }
+	    }
+      }
+    Unlink (thread);
+    numDispatches[l]++;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SpaceOf
+//      Return the pid of the process of "thread", -1 for a kernel thread.
+//----------------------------------------------------------------------
+
+int
+Scheduler::SpaceOf (Thread * thread)
+{
+#ifdef USER_PROGRAM
+    if (thread->space != NULL)
+	return thread->space->GetPid ();
+#endif
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::GangOpen
+//      Is the process whose address space is loaded still to be
+//      preferred?  Only for "gangWindow" ticks after it was loaded, so
+//      that the others are not starved.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::GangOpen ()
+{
+    return gangWindow > 0 && lastSpace >= 0
+	&& stats->totalTicks - spaceSince < gangWindow;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::GangMember
+//      Return the first thread of the process whose address space is
+//      loaded on "queue", or NULL.  This walks the queue: only paid while
+//      the gang window is open, and the head of the queue belongs to
+//      another process.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::GangMember (ReadyQueue * queue)
+{
+    for (Thread * t = queue->head; t != NULL; t = t->readyNext)
+	if (SpaceOf (t) == lastSpace)
+	    return t;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PickGroup
+//      Choose the share group whose thread runs next: under STRIDE, the
+//      one with the lowest pass, under LOTTERY, the one holding a ticket
+//      drawn at random.  Only groups with ready threads take part.
+//      Return NULL if there are none.
+//
+//      While the gang window is open, the group of the process loaded
+//      keeps the CPU if it has a ready thread; under STRIDE its pass
+//      still grows, so it gets less later.
+//----------------------------------------------------------------------
+
+ShareGroup *
+Scheduler::PickGroup ()
+{
+    ShareGroup *group, *best = NULL;
+    int total = 0, winner;
+
+    if (GangOpen ())
+	for (group = groups; group != NULL; group = group->next)
+	    if (group->id == lastSpace && group->numReady > 0)
+	      {
+		  numGangPicks++;
+		  return group;
+	      }
+
+    if (policy == POLICY_STRIDE)
+      {
+	  for (group = groups; group != NULL; group = group->next)
+	      if (group->numReady > 0
+		  && (best == NULL || group->pass < best->pass))
+		  best = group;
+	  if (best != NULL)
+	      virtualTime = best->pass;
+	  return best;
+      }
+
+    for (group = groups; group != NULL; group = group->next)
+	if (group->numReady > 0)
+	    total += group->tickets;
+    if (total == 0)
+	return NULL;
+    winner = Random () % total;
+    for (group = groups; group != NULL; group = group->next)
+	if (group->numReady > 0)
+	  {
+	      if (winner < group->tickets)
+		  return group;
+	      winner -= group->tickets;
+	  }
+    ASSERT (FALSE);
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Charge
+//      Account for the CPU time used by "thread" since it was last
+//      dispatched, and under MLFQ, move it to its new level: down if it
+//      used up its quantum, up if it gave the CPU back early.  A
+//      real-time thread is charged against its budget instead.
+//      Does nothing if the thread was charged already.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Charge (Thread * thread)
+{
+    long long used;
+
+    if (thread->dispatchedAt < 0)
+	return;
+    used = stats->totalTicks - thread->dispatchedAt;
+    thread->dispatchedAt = -1;
+    if (thread->rtPeriod > 0)
+      {
+	  if (thread->rtRemaining > 0 && thread->rtRemaining <= used)
+	      rtOverruns++;
+	  thread->rtRemaining -= used;
+	  rtTicks += used;
+	  return;
+      }
+    ticksRun[thread->level] += used;
+    if (policy == POLICY_STRIDE || policy == POLICY_LOTTERY)
+      {
+	  ShareGroup *group = GroupOf (thread);
+
+	  group->ticksRun += used;
+	  if (policy == POLICY_STRIDE)
+	      group->pass += used * StrideOne / group->tickets;
+      }
+    if (policy != POLICY_MLFQ)
+	return;
+
+    if (used >= SliceOf (thread))
+      {
+	  if (thread->level < numLevels - 1)
+	    {
+		thread->level++;
+		numDemotions++;
+	    }
+      }
+    else if (used < SliceOf (thread) / 2 && thread->level > 0)
+      {
+	  thread->level--;
+	  numPromotions++;
+      }
+    DEBUG ('t', "Thread %s ran %d ticks, now at level %d\n",
+	   thread->getName (), (int) used, thread->level);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Boost
+//      Move every ready thread to the top level.  Running and blocked
+//      threads are moved by ReadyToRun, next time they are queued.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Boost ()
+{
+    Thread *thread;
+
+    epoch++;
+    lastBoost = stats->totalTicks;
+    for (int i = 1; i < numLevels; i++)
+	while ((thread = ready[i].head) != NULL)
+	  {
+	      Unlink (thread);
+	      thread->level = 0;
+	      thread->epoch = epoch;
+	      Enqueue (thread);
+	  }
+    DEBUG ('t', "Priority boost %d\n", epoch);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Outranked
+//      Return TRUE if a thread of a higher level than the running one is
+//      ready to run, or a real-time thread with an earlier deadline.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::Outranked ()
+{
+    int l;
+
+    if (rtReady.head != NULL && (currentThread->rtPeriod == 0
+				 || rtReady.head->rtDeadline <
+				 currentThread->rtDeadline))
+	return TRUE;
+    if (currentThread->rtPeriod > 0)
+	return FALSE;
+    l = HighestReady ();
+    return l >= 0 && l < currentThread->level;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ShouldPreempt
+//      Called on each timer interrupt.  FIFO preempts the running thread
+//      every time, unless a quantum was set; the other policies only
+//      once its quantum is used up, or if a thread of a higher level is
+//      ready.
+//
+//      The timer interrupts every TimerTicks, so quanta are only
+//      enforced with this granularity.  Real-time threads have no
+//      quantum, only a budget.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::ShouldPreempt ()
+{
+    if (currentThread->rtPeriod > 0 || rtReady.head != NULL)
+	return Outranked ();
+    if (policy == POLICY_FIFO && everyTick && currentThread->timeSlice == 0)
+	return TRUE;
+    return stats->totalTicks - currentThread->dispatchedAt >=
+	SliceOf (currentThread) || Outranked ();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SliceOf
+//      Return the quantum of a thread: the one it set, or the one of
+//      its level.
+//----------------------------------------------------------------------
+
+int
+Scheduler::SliceOf (Thread * thread)
+{
+    if (thread->timeSlice > 0)
+	return thread->timeSlice;
+    if (policy == POLICY_MLFQ)
+	return quantum[thread->level];
+    return quantum[0];
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetPriority
+//      Change the fixed priority of a thread, moving it to the ready
+//      list of its new level if it is ready.  The caller should yield if
+//      Outranked() then returns TRUE.  Interrupts must be disabled.
+//
+//      Return the previous priority.
+//----------------------------------------------------------------------
+
+int
+Scheduler::SetPriority (Thread * thread, int newPriority)
+{
+    int old = thread->priority;
+
+    ASSERT (interrupt->getLevel () == IntOff);
+    ASSERT (newPriority >= 0 && newPriority < NumPriorities);
+    thread->priority = newPriority;
+    if (policy != POLICY_PRIORITY || thread->rtPeriod > 0)
+	return old;		// only used once PRIORITY is selected, by
+    // best-effort threads
+
+    if (thread->getStatus () == READY)
+      {
+	  Unlink (thread);
+	  thread->level = newPriority;
+	  Enqueue (thread);
+      }
+    else
+	thread->level = newPriority;
+    return old;
 }
 
 //----------------------------------------------------------------------
@@ -96,19 +637,23 @@ Scheduler::Run (Thread * nextThread)
     ASSERT (interrupt->getLevel () == IntOff);
     // End of addition
 
-#ifdef USER_PROGRAM		// ignore until running user programs
-    if (currentThread->space != NULL)
-      {				// if this thread is a user program,
-	  currentThread->SaveUserState ();	// save the user's CPU registers
-	  currentThread->space->SaveState ();
-      }
-#endif
+    Account (oldThread);
+    nextThread->userMark = stats->userTicks;
+    nextThread->systemMark = stats->systemTicks;
+    nextThread->waitTicks += stats->totalTicks - nextThread->readySince;
+    numSwitches++;
+
+    // The user registers and address space of oldThread stay in the
+    // machine until another user thread needs it, see LoadUserState
 
     oldThread->CheckOverflow ();	// check if the old thread
     // had an undetected stack overflow
 
     currentThread = nextThread;	// switch to the next thread
     currentThread->setStatus (RUNNING);	// nextThread is now running
+    currentThread->dispatchedAt = stats->totalTicks;
+    if (currentThread->rtPeriod > 0)
+	RtArmNext ();		// for the end of its budget
 
     DEBUG ('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	   oldThread->getName (), nextThread->getName ());
@@ -133,22 +678,569 @@ Scheduler::Run (Thread * nextThread)
       }
 
 #ifdef USER_PROGRAM
-    if (currentThread->space != NULL)
-      {				// if there is an address space
-	  currentThread->RestoreUserState ();	// to restore, do it.
-	  currentThread->space->RestoreState ();
+    if (currentThread->space != NULL)	// if there is an address space
+	LoadUserState (currentThread);	// to restore, do it.
+#endif
+}
+
+//----------------------------------------------------------------------
+// Scheduler::LoadUserState
+//      Make the machine run the user program of "thread", the running
+//      thread, lazily: its registers are only loaded if another user
+//      thread used the machine since it last did, and its page table if
+//      that thread was in another process.  The registers of the last
+//      owner are saved only then, so switching to a kernel thread and
+//      back, or between the threads of a process, costs less.
+//
+//      Address spaces are identified by their pid, which is never
+//      reused, since the one loaded may have been deleted since.
+//----------------------------------------------------------------------
+
+void
+Scheduler::LoadUserState (Thread * thread)
+{
+#ifdef USER_PROGRAM
+    ASSERT (thread == currentThread && thread->space != NULL);
+    if (regsOwner != thread)
+      {
+	  if (regsOwner != NULL)
+	    {
+		regsOwner->SaveUserState ();
+		numRegSaves++;
+	    }
+	  thread->RestoreUserState ();
+	  numRegLoads++;
+	  regsOwner = thread;
+      }
+    if (thread->space->GetPid () != lastSpace)
+      {
+	  thread->space->RestoreState ();
+	  lastSpace = thread->space->GetPid ();
+	  spaceSince = stats->totalTicks;
+	  numSpaceSwitches++;
+      }
+#endif
+}
+
+//----------------------------------------------------------------------
+// Scheduler::AddGroup, Scheduler::RemoveGroup
+//      Register the share group of a new process, or forget the one of
+//      a process whose last thread is exiting: that thread is charged
+//      its CPU time now, while its group is still there.  Interrupts
+//      must be disabled.
+//----------------------------------------------------------------------
+
+void
+Scheduler::AddGroup (ShareGroup * group)
+{
+    ShareGroup *last;
+
+    ASSERT (interrupt->getLevel () == IntOff);
+    EndSharePeriod ();
+    group->pass = virtualTime;
+    last = groups;
+    while (last->next != NULL)
+	last = last->next;
+    last->next = group;
+}
+
+void
+Scheduler::RemoveGroup (ShareGroup * group)
+{
+    ShareGroup *prev;
+
+    ASSERT (interrupt->getLevel () == IntOff);
+    ASSERT (group->numReady == 0);
+    if (GroupOf (currentThread) == group)
+	Charge (currentThread);
+    EndSharePeriod ();
+    for (prev = groups; prev->next != group; prev = prev->next)
+	ASSERT (prev->next != NULL);
+    prev->next = group->next;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetTickets
+//      Change the number of tickets of a share group.  Interrupts must
+//      be disabled.
+//
+//      Return the previous number.
+//----------------------------------------------------------------------
+
+int
+Scheduler::SetTickets (ShareGroup * group, int tickets)
+{
+    int old = group->tickets;
+
+    ASSERT (interrupt->getLevel () == IntOff);
+    ASSERT (tickets > 0 && tickets <= MaxTickets);
+    EndSharePeriod ();
+    group->tickets = tickets;
+    return old;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::EndSharePeriod
+//      The groups, or their tickets, are about to change: the shares
+//      they asked for too.  With the 'S' debug flag, print what each
+//      group asked for and got since the last change, then start
+//      counting again.
+//----------------------------------------------------------------------
+
+void
+Scheduler::EndSharePeriod ()
+{
+    if (policy != POLICY_STRIDE && policy != POLICY_LOTTERY)
+	return;
+    if (DebugIsEnabled ('S'))
+	PrintShares ();
+    for (ShareGroup * group = groups; group != NULL; group = group->next)
+	group->ticksRun = 0;
+    periodStart = stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PrintShares
+//      Print the share of the CPU each group asked for -- its part of
+//      the tickets -- and the one it got -- its part of the CPU time
+//      used -- since the groups or their tickets last changed.  The
+//      kernel group is left out if it did not run.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PrintShares ()
+{
+    ShareGroup *group;
+    long long totalTicks = 0;
+    int totalTickets = 0;
+
+    for (group = groups; group != NULL; group = group->next)
+	if (group != &kernelGroup || group->ticksRun > 0)
+	  {
+	      totalTicks += group->ticksRun;
+	      totalTickets += group->tickets;
+	  }
+    if (totalTicks == 0)
+	return;
+    printf ("CPU shares from tick %lld to %lld:\n", periodStart,
+	    stats->totalTicks);
+    for (group = groups; group != NULL; group = group->next)
+	if (group != &kernelGroup || group->ticksRun > 0)
+	    printf ("  process %d: %d tickets, %.1f%% requested, "
+		    "%.1f%% achieved\n", group->id, group->tickets,
+		    100.0 * group->tickets / totalTickets,
+		    100.0 * group->ticksRun / totalTicks);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetRealTime
+//      Admit "thread" to the real-time class: from now on, it gets
+//      "budget" ticks of CPU in each period of "period" ticks, before
+//      any best-effort thread.  Admission control refuses it if the
+//      real-time threads would then use more than RtMaxUtilization of
+//      the CPU.  A 0 budget makes the thread best-effort again.
+//      Interrupts must be disabled.
+//
+//      Return 0, or -1 if the thread is not admitted.
+//----------------------------------------------------------------------
+
+int
+Scheduler::SetRealTime (Thread * thread, int budget, int period)
+{
+    int share = 0, oldShare = 0;
+
+    ASSERT (interrupt->getLevel () == IntOff);
+    ASSERT (budget == 0 || (budget > 0 && budget <= period
+			    && period >= RtMinPeriod));
+    if (budget > 0)
+	share = (int) ((long long) budget * RtUnit / period);
+    if (thread->rtPeriod > 0)
+	oldShare = (int) ((long long) thread->rtBudget * RtUnit
+			  / thread->rtPeriod);
+    if (rtUtilization - oldShare + share > RtMaxUtilization)
+      {
+	  rtRejected++;
+	  return -1;
+      }
+
+    // the time run so far belongs to the old class
+    if (thread == currentThread)
+      {
+	  Charge (thread);
+	  thread->dispatchedAt = stats->totalTicks;
+      }
+    else if (thread->getStatus () == READY)
+      {
+	  if (thread->rtPeriod == 0)
+	      Unlink (thread);
+	  else if (thread->rtRemaining > 0)
+	      RtRemove (&rtReady, thread);
+	  else
+	      RtRemove (&rtThrottled, thread);
+      }
+
+    rtUtilization += share - oldShare;
+    thread->rtBudget = budget;
+    thread->rtPeriod = (budget > 0) ? period : 0;
+    if (budget > 0)
+      {
+	  rtAdmitted++;
+	  rtPeriods++;
+	  thread->rtDeadline = stats->totalTicks + period;
+	  thread->rtRemaining = budget;
+      }
+    if (thread != currentThread && thread->getStatus () == READY)
+	ReadyToRun (thread);
+    else if (thread == currentThread && budget > 0)
+	RtArmNext ();
+    DEBUG ('t', "Thread %s real-time budget %d period %d\n",
+	   thread->getName (), budget, period);
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::RtInsert, Scheduler::RtRemove
+//      Put a real-time thread on one of their lists, in deadline order,
+//      or take it off.
+//----------------------------------------------------------------------
+
+void
+Scheduler::RtInsert (ReadyQueue * queue, Thread * thread)
+{
+    Thread *after = queue->tail;
+
+    while (after != NULL && after->rtDeadline > thread->rtDeadline)
+	after = after->readyPrev;
+    thread->readyPrev = after;
+    thread->readyNext = (after == NULL) ? queue->head : after->readyNext;
+    if (after == NULL)
+	queue->head = thread;
+    else
+	after->readyNext = thread;
+    if (thread->readyNext == NULL)
+	queue->tail = thread;
+    else
+	thread->readyNext->readyPrev = thread;
+}
+
+void
+Scheduler::RtRemove (ReadyQueue * queue, Thread * thread)
+{
+    if (thread->readyPrev == NULL)
+	queue->head = thread->readyNext;
+    else
+	thread->readyPrev->readyNext = thread->readyNext;
+    if (thread->readyNext == NULL)
+	queue->tail = thread->readyPrev;
+    else
+	thread->readyNext->readyPrev = thread->readyPrev;
+    thread->readyNext = thread->readyPrev = NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::RtNewPeriod
+//      Start the period of "thread" which contains the present time,
+//      with a full budget.
+//----------------------------------------------------------------------
+
+void
+Scheduler::RtNewPeriod (Thread * thread)
+{
+    long long late = stats->totalTicks - thread->rtDeadline;
+    long long periods = late / thread->rtPeriod + 1;
+
+    ASSERT (late >= 0);
+    thread->rtDeadline += periods * thread->rtPeriod;
+    thread->rtRemaining = thread->rtBudget;
+    rtPeriods += periods;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::RtReady
+//      Put a real-time thread on the ready list, or if it used up the
+//      budget of its period, on the throttled list until the next one.
+//      A thread which blocked past the end of its period starts a new
+//      one.  Preempt the running thread soon if the new one has an
+//      earlier deadline.
+//----------------------------------------------------------------------
+
+void
+Scheduler::RtReady (Thread * thread)
+{
+    thread->setStatus (READY);
+    if (thread->rtDeadline <= stats->totalTicks)
+	RtNewPeriod (thread);
+    if (thread->rtRemaining <= 0)
+	RtInsert (&rtThrottled, thread);
+    else
+      {
+	  RtInsert (&rtReady, thread);
+	  if (thread != currentThread && Outranked ())
+	      RtArm (stats->totalTicks + 1);
+      }
+    RtArmNext ();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::RtArm, Scheduler::RtArmNext
+//      Make sure a budget interrupt happens at "when", unless an earlier
+//      one is already due; or at the next time a budget or a period of
+//      a real-time thread ends.
+//----------------------------------------------------------------------
+
+void
+Scheduler::RtArm (long long when)
+{
+    long long now = stats->totalTicks;
+
+    if (when <= now)
+	when = now + 1;
+    if (rtArmedAt >= 0 && rtArmedAt <= when)
+	return;
+    interrupt->Schedule (BudgetHandler, (int) this, when - now, BudgetInt);
+    rtArmedAt = when;
+}
+
+void
+Scheduler::RtArmNext ()
+{
+    long long next = -1;
+    Thread *t;
+
+    if (currentThread->rtPeriod > 0 && currentThread->getStatus () == RUNNING)
+      {
+	  next = currentThread->rtDeadline;
+	  if (currentThread->rtRemaining > 0
+	      && currentThread->dispatchedAt + currentThread->rtRemaining < next)
+	      next = currentThread->dispatchedAt + currentThread->rtRemaining;
       }
+    // the lists are sorted: only their heads matter
+    if ((t = rtReady.head) != NULL && (next < 0 || t->rtDeadline < next))
+	next = t->rtDeadline;
+    if ((t = rtThrottled.head) != NULL && (next < 0 || t->rtDeadline < next))
+	next = t->rtDeadline;
+    if (next >= 0)
+	RtArm (next);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::BudgetExpired
+//      Called by the budget interrupt.  Count the periods which ended
+//      while their thread was still ready to run as deadline misses,
+//      start the new periods, give the throttled threads their new
+//      budget, and preempt the running thread if it used up its budget
+//      or a thread with an earlier deadline is now ready.
+//----------------------------------------------------------------------
+
+void
+Scheduler::BudgetExpired ()
+{
+    long long now = stats->totalTicks;
+    Thread *t;
+
+    if (rtArmedAt >= 0 && rtArmedAt <= now)
+	rtArmedAt = -1;
+
+    if (currentThread->rtPeriod > 0 && currentThread->getStatus () == RUNNING)
+      {
+	  Charge (currentThread);	// up to now
+	  currentThread->dispatchedAt = now;
+	  if (currentThread->rtDeadline <= now)
+	    {
+		if (currentThread->rtRemaining > 0)
+		    rtMisses++;
+		RtNewPeriod (currentThread);
+	    }
+      }
+    while ((t = rtReady.head) != NULL && t->rtDeadline <= now)
+      {
+	  rtMisses++;
+	  RtRemove (&rtReady, t);
+	  RtNewPeriod (t);
+	  RtInsert (&rtReady, t);
+      }
+    while ((t = rtThrottled.head) != NULL && t->rtDeadline <= now)
+      {
+	  RtRemove (&rtThrottled, t);
+	  RtNewPeriod (t);
+	  RtInsert (&rtReady, t);
+      }
+
+    if (interrupt->getStatus () != IdleMode
+	&& ((currentThread->rtPeriod > 0 && currentThread->rtRemaining <= 0)
+	    || Outranked ()))
+	interrupt->YieldOnReturn ();
+    RtArmNext ();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Account
+//      Add the user and system time used since the last call to the
+//      counters of "thread", which must be the running one.  Time spent
+//      idle, waiting for an interrupt, is nobody's.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Account (Thread * thread)
+{
+    thread->userTicks += stats->userTicks - thread->userMark;
+    thread->systemTicks += stats->systemTicks - thread->systemMark;
+    thread->userMark = stats->userTicks;
+    thread->systemMark = stats->systemTicks;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::AddThread, Scheduler::RemoveThread
+//      Keep the list of all the threads, for PrintThreads.
+//----------------------------------------------------------------------
+
+void
+Scheduler::AddThread (Thread * thread)
+{
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    thread->allPrev = NULL;
+    thread->allNext = allThreads;
+    if (allThreads != NULL)
+	allThreads->allPrev = thread;
+    allThreads = thread;
+    (void) interrupt->SetLevel (oldLevel);
+}
+
+void
+Scheduler::RemoveThread (Thread * thread)
+{
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    if (thread->allPrev == NULL)
+	allThreads = thread->allNext;
+    else
+	thread->allPrev->allNext = thread->allNext;
+    if (thread->allNext != NULL)
+	thread->allNext->allPrev = thread->allPrev;
+    if (regsOwner == thread)
+	regsOwner = NULL;	// its registers are not worth saving
+    (void) interrupt->SetLevel (oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PrintThreads
+//      Print a line for each thread: its user thread id and process,
+//      state, quantum, and the CPU time it used and waited for.  The
+//      counters of the running thread are brought up to date first.
+//----------------------------------------------------------------------
+
+void
+Scheduler::PrintThreads ()
+{
+    static const char *statusNames[] =
+	{ "new", "running", "ready", "blocked" };
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    Account (currentThread);
+    printf ("  PID  TID STATUS   QUANTUM       USER     SYSTEM       WAIT NAME\n");
+    for (Thread * t = allThreads; t != NULL; t = t->allNext)
+      {
+	  int pid = -1, tid = -1;
+#ifdef USER_PROGRAM
+	  if (t->space != NULL)
+	    {
+		pid = t->space->GetPid ();
+		tid = t->tid;
+	    }
 #endif
+	  printf ("%5d %4d %-8s %7d %10lld %10lld %10lld %s\n", pid, tid,
+		  statusNames[t->getStatus ()], SliceOf (t), t->userTicks,
+		  t->systemTicks, t->waitTicks, t->getName ());
+      }
+    (void) interrupt->SetLevel (oldLevel);
 }
 
 //----------------------------------------------------------------------
 // Scheduler::Print
 //      Print the scheduler state -- in other words, the contents of
-//      the ready list.  For debugging.
+//      the ready lists.  For debugging.
 //----------------------------------------------------------------------
 void
 Scheduler::Print ()
 {
     printf ("Ready list contents:\n");
-    readyList->Mapcar ((VoidFunctionPtr) ThreadPrint);
+    for (int i = 0; i < numLevels; i++)
+      {
+	  if (ready[i].head == NULL && numLevels > 1)
+	      continue;
+	  if (numLevels > 1)
+	      printf ("level %d: ", i);
+	  for (Thread * t = ready[i].head; t != NULL; t = t->readyNext)
+	      t->Print ();
+	  printf ("\n");
+      }
+    if (rtReady.head != NULL || rtThrottled.head != NULL)
+      {
+	  printf ("real-time: ");
+	  for (Thread * t = rtReady.head; t != NULL; t = t->readyNext)
+	      t->Print ();
+	  printf ("\nthrottled: ");
+	  for (Thread * t = rtThrottled.head; t != NULL; t = t->readyNext)
+	      t->Print ();
+	  printf ("\n");
+      }
+    if (policy != POLICY_STRIDE && policy != POLICY_LOTTERY)
+	return;
+    for (ShareGroup * group = groups; group != NULL; group = group->next)
+      {
+	  printf ("process %d, %d tickets: ", group->id, group->tickets);
+	  for (Thread * t = group->ready.head; t != NULL; t = t->readyNext)
+	      t->Print ();
+	  printf ("\n");
+      }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::PrintStats
+//      Print how many threads were dispatched from each level, the CPU
+//      time they used there, and how long the list of each level was:
+//      on average, as seen by each thread put on it, and at most.  Under
+//      PRIORITY, the levels never used are left out.
+//----------------------------------------------------------------------
+void
+Scheduler::PrintStats ()
+{
+    if (policy == POLICY_MLFQ)
+	printf ("Scheduler: MLFQ, %d levels, %d boosts, %d promotions, "
+		"%d demotions\n", numLevels, epoch, numPromotions,
+		numDemotions);
+    else if (policy == POLICY_PRIORITY)
+	printf ("Scheduler: PRIORITY, time slice %d\n", quantum[0]);
+    else if (policy == POLICY_STRIDE || policy == POLICY_LOTTERY)
+	printf ("Scheduler: %s, quantum %d\n",
+		policy == POLICY_STRIDE ? "STRIDE" : "LOTTERY", quantum[0]);
+    else
+	printf ("Scheduler: FIFO\n");
+    for (int i = 0; i < numLevels; i++)
+      {
+	  if (policy == POLICY_PRIORITY && numQueued[i] == 0)
+	      continue;
+	  printf ("  level %d, quantum %d: %d dispatches, %lld ticks, "
+		  "queue avg %.2f max %d\n", i, quantum[i], numDispatches[i],
+		  ticksRun[i],
+		  numQueued[i] > 0 ? (double) sumReady[i] / numQueued[i] : 0.0,
+		  maxReady[i]);
+      }
+    if (rtAdmitted > 0 || rtRejected > 0)
+	printf ("Real-time: %d admitted, %d rejected, %d periods, "
+		"%d deadline misses, %d budget overruns, %lld ticks\n",
+		rtAdmitted, rtRejected, rtPeriods, rtMisses, rtOverruns,
+		rtTicks);
+    if (numRegLoads > 0)
+	printf ("Context switches: %d, user registers saved %d times, "
+		"loaded %d times\n", numSwitches, numRegSaves, numRegLoads);
+    if (numSpaceSwitches > 0)
+	printf ("Address space switches: %d, %.2f per 1000 ticks, "
+		"gang window %d, %d gang picks\n", numSpaceSwitches,
+		stats->totalTicks > 0 ?
+		numSpaceSwitches * 1000.0 / stats->totalTicks : 0.0,
+		gangWindow, numGangPicks);
+    if (policy == POLICY_STRIDE || policy == POLICY_LOTTERY)
+	PrintShares ();
 }
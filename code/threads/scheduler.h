@@ -2,6 +2,38 @@
 //      Data structures for the thread dispatcher and scheduler.
 //      Primarily, the list of threads that are ready to run.
 //
+//      Five policies are available.  FIFO (the default) keeps a single
+//      ready list and preempts the running thread on every timer
+//      interrupt.  MLFQ keeps one ready list per priority level; each
+//      level has its own quantum, twice the one of the level above.
+//      PRIORITY keeps one ready list for each of the NumPriorities fixed
+//      priorities, set with SetPriority.  STRIDE and LOTTERY divide the
+//      CPU between share groups -- the processes -- in proportion to
+//      their tickets, whatever their number of threads: each group has
+//      its own ready list.
+//
+//      Above whichever of them is selected, threads admitted to the
+//      real-time class (SetRealTime) are scheduled earliest deadline
+//      first, and preempt all the others.  Each gets "budget" ticks of
+//      CPU every "period" ticks, its deadline being the end of the
+//      period; the sum of budget / period is capped by admission
+//      control.  A budget interrupt enforces the budgets and starts the
+//      periods.
+//
+//      With a gang window, the threads of the process which last had the
+//      CPU are preferred to the others of the same level, or share
+//      group, until the process has held the CPU for that many ticks:
+//      the threads of a process then run back to back, and switching
+//      address spaces, with the state saved and restored, is rarer.
+//
+//      The ready lists are linked through the threads themselves, and a
+//      bitmap of the non-empty ones finds the highest ready level with a
+//      find-first-set, so that no decision depends on the number of
+//      threads -- except with a gang window under FIFO, MLFQ and
+//      PRIORITY: while it is open and the head of the highest level
+//      belongs to another process, that level is walked to find a
+//      thread of the loaded one, which costs O(ready threads) per pick.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -10,8 +42,53 @@
 #define SCHEDULER_H
 
 #include "copyright.h"
-#include "list.h"
 #include "thread.h"
+#include "stats.h"
+
+enum SchedPolicy
+{ POLICY_FIFO, POLICY_MLFQ, POLICY_PRIORITY, POLICY_STRIDE, POLICY_LOTTERY };
+
+#define MaxMlfqLevels	8	// max number of MLFQ priority levels
+#define MaxSchedLevels	NumPriorities
+#define ReadyMaskWords	((MaxSchedLevels + 31) / 32)
+#define BoostQuanta	4	// MLFQ boosts every thread back to the
+				// top level once per this many quanta of
+				// the bottom level
+#define DefaultTickets	100	// CPU tickets of a new share group
+#define MaxTickets	10000
+#define StrideOne	(1 << 20)	// pass advance of a one-ticket group
+					// for one tick of CPU
+#define RtUnit		1000000	// utilization of a thread using the
+				// whole CPU
+#define RtMaxUtilization 900000	// admission control: the real-time
+				// threads leave 10% to the others
+#define RtMinPeriod	TimerTicks
+#define MaxQuantum	100000	// longest quantum a thread may set
+
+// A list of ready threads, linked through the threads themselves
+struct ReadyQueue
+{
+    Thread *head;
+    Thread *tail;
+};
+
+// The threads sharing a number of CPU tickets under the STRIDE and
+// LOTTERY policies: those of a user process, or the kernel threads.
+// The tickets are split between the threads of the group by running
+// them in turn.
+class ShareGroup
+{
+  public:
+    ShareGroup (int groupId);	// DefaultTickets, no ready thread
+
+    int id;			// the pid, 0 for the kernel threads
+    int tickets;
+    long long pass;		// STRIDE: CPU used, weighted by 1/tickets
+    ReadyQueue ready;		// its threads ready to run
+    int numReady;
+    long long ticksRun;		// CPU used in the current share period
+    ShareGroup *next;		// in the list of all the groups
+};
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
@@ -20,18 +97,126 @@
 class Scheduler
 {
   public:
-    Scheduler ();		// Initialize list of ready threads 
+    Scheduler (SchedPolicy policy = POLICY_FIFO, int levels = 1,
+	       int quantum = 0, int gang = 0);
+    				// Initialize list of ready threads 
     ~Scheduler ();		// De-allocate ready list
+    SchedPolicy getPolicy ()
+    {
+	return policy;
+    }
 
     void ReadyToRun (Thread * thread);	// Thread can be dispatched.
     Thread *FindNextToRun ();	// Dequeue first thread on the ready 
     // list, if any, and return thread.
     void Run (Thread * nextThread);	// Cause nextThread to start running
+    bool ShouldPreempt ();	// Called on timer interrupts: is the
+    // running thread to give up the CPU?
+    int SliceOf (Thread * thread);	// Its quantum, in ticks
+    void Account (Thread * thread);	// Bring the CPU time of the
+    // running thread up to date
+    void AddThread (Thread * thread);	// Called by Thread constructor
+    void RemoveThread (Thread * thread);	// and destructor
+    void PrintThreads ();	// ps-like list of all the threads
+    void LoadUserState (Thread * thread);	// Give the machine to the
+    // running user thread
+    bool Outranked ();		// Is a thread of a higher level than
+    // the running one ready?
+    int SetPriority (Thread * thread, int priority);	// Change the
+    // priority of a thread, return the previous one
+    void AddGroup (ShareGroup * group);	// A process was created
+    void RemoveGroup (ShareGroup * group);	// A process is exiting
+    int SetTickets (ShareGroup * group, int tickets);	// Change the
+    // CPU share of a group, return its previous tickets
+    int SetRealTime (Thread * thread, int budget, int period);
+    // Admit a thread to the real-time class, or take it out with a 0
+    // budget, return -1 if it cannot be admitted
+    void BudgetExpired ();	// Budget interrupt handler
     void Print ();		// Print contents of ready list
+    void PrintStats ();		// Print per-level statistics
 
   private:
-      List * readyList;		// queue of threads that are ready to run,
-    // but not running
+    void Enqueue (Thread * thread);	// append to the list of its level
+    void Unlink (Thread * thread);	// remove from the list of its level
+    int HighestReady ();	// first non-empty level, -1 if none
+    ReadyQueue *QueueOf (Thread * thread);	// list the thread goes on
+    ShareGroup *GroupOf (Thread * thread);
+    ShareGroup *PickGroup ();	// STRIDE or LOTTERY choice of the next
+    // group to run, NULL if no thread is ready
+    int SpaceOf (Thread * thread);	// pid of its process, -1 if none
+    bool GangOpen ();		// is the gang window still open?
+    Thread *GangMember (ReadyQueue * queue);	// first thread of the
+    // current process on "queue", NULL if none
+    void EndSharePeriod ();	// the set of groups or their tickets change
+    void PrintShares ();	// requested vs achieved CPU share
+    void RtInsert (ReadyQueue * queue, Thread * thread);	// sorted
+    // by deadline
+    void RtRemove (ReadyQueue * queue, Thread * thread);
+    void RtReady (Thread * thread);	// ReadyToRun of a real-time thread
+    void RtNewPeriod (Thread * thread);	// first period after now
+    void RtArm (long long when);	// budget interrupt at "when"
+    void RtArmNext ();		// at the next budget or period end
+    void Charge (Thread * thread);	// account for the CPU time
+    // used by thread, and move it to its new level
+    void Boost ();		// move every thread to the top level
+
+    SchedPolicy policy;
+    int numLevels;		// 1 for FIFO
+    ReadyQueue ready[MaxSchedLevels];	// queues of threads that are
+    // ready to run, but not running, highest priority first
+    unsigned int readyMask[ReadyMaskWords];	// bit i set iff the
+    // queue of level i is not empty
+    int quantum[MaxSchedLevels];	// ticks a thread may run at
+    // each level before it is preempted, unless it sets its own
+    bool everyTick;		// FIFO: preempt at each timer interrupt,
+    // as long as no quantum was set
+    Thread *allThreads;		// every thread which exists
+    long long boostInterval;	// ticks between two priority boosts
+    long long lastBoost;	// time of the last boost
+    int epoch;			// number of boosts so far
+    ShareGroup kernelGroup;	// threads without an address space
+    ShareGroup *groups;		// all the groups, kernelGroup first
+    long long virtualTime;	// STRIDE: pass of the last group chosen
+    int gangWindow;		// ticks a process keeps the CPU for its
+    // own threads, 0 if gang scheduling is off
+    int lastSpace;		// pid of the address space loaded in the
+    // machine, -1 if none
+    long long spaceSince;	// time it was loaded
+    Thread *regsOwner;		// user thread whose registers are in the
+    // machine, NULL if none
+    long long periodStart;	// time the current share period began
+    ReadyQueue rtReady;		// real-time threads, earliest deadline
+    // first
+    ReadyQueue rtThrottled;	// real-time threads which used up their
+    // budget, until their next period
+    int rtUtilization;		// of the admitted threads, in RtUnit
+    long long rtArmedAt;	// time of the next budget interrupt, -1
+    // if none
+
+    // statistics
+    int numReady[MaxSchedLevels];	// current length of each queue,
+    // or of all the group queues
+    int maxReady[MaxSchedLevels];	// longest length of each queue
+    long long sumReady[MaxSchedLevels];	// sum of the lengths, seen
+    // by each thread queued
+    int numQueued[MaxSchedLevels];	// threads queued at each level
+    int numDispatches[MaxSchedLevels];	// threads taken from each level
+    long long ticksRun[MaxSchedLevels];	// CPU time used at each level
+    int numPromotions;
+    int numDemotions;
+    int rtAdmitted;		// SetRealTime calls accepted
+    int rtRejected;		// and refused by admission control
+    int rtPeriods;		// periods started
+    int rtMisses;		// periods which ended before their thread
+    // got its budget, while it was ready
+    int rtOverruns;		// budgets used up before the period ended
+    long long rtTicks;		// CPU used by the real-time threads
+    int numSwitches;		// calls to Run
+    int numRegSaves;		// user register sets saved
+    int numRegLoads;		// and loaded
+    int numSpaceSwitches;	// address spaces loaded
+    int numGangPicks;		// threads run out of order to stay in
+    // the same address space
 };
 
 #endif // SCHEDULER_H
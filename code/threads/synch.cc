@@ -1,8 +1,7 @@
 // synch.cc 
 //      Routines for synchronizing threads.  Three kinds of
 //      synchronization routines are defined here: semaphores, locks 
-//      and condition variables (the implementation of the last two
-//      are left to the reader).
+//      and condition variables.
 //
 // Any implementation of a synchronization routine needs some
 // primitive atomic operation.  We assume Nachos is running on
@@ -38,6 +37,7 @@ Semaphore::Semaphore (const char *debugName, int initialValue)
     name = debugName;
     value = initialValue;
     queue = new List;
+    profile = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -65,7 +65,10 @@ void
 Semaphore::P ()
 {
     IntStatus oldLevel = interrupt->SetLevel (IntOff);	// disable interrupts
+    long long waitStart = -1;
 
+    if (synchProfiler != NULL && value == 0)
+	waitStart = stats->totalTicks;
     while (value == 0)
       {				// semaphore not available
 	  queue->Append ((void *) currentThread);	// so go to sleep
@@ -73,6 +76,8 @@ Semaphore::P ()
       }
     value--;			// semaphore available, 
     // consume its value
+    if (synchProfiler != NULL)
+	synchProfiler->Record (&profile, name, waitStart);
 
     (void) interrupt->SetLevel (oldLevel);	// re-enable interrupts
 }
@@ -98,43 +103,646 @@ Semaphore::V ()
     (void) interrupt->SetLevel (oldLevel);
 }
 
-// Dummy functions -- so we can compile our later assignments 
-// Note -- without a correct implementation of Condition::Wait(), 
-// the test case in the network assignment won't work!
-Lock::Lock (const char *debugName)
+//----------------------------------------------------------------------
+// WaitAppend, WaitRemove
+//      Add a thread at the end of a wait queue, take the first one out,
+//      NULL if none.  Interrupts must be disabled.
+//----------------------------------------------------------------------
+
+static void
+WaitAppend (WaitQueue * queue, Thread * thread)
+{
+    thread->waitNext = NULL;
+    if (queue->tail == NULL)
+	queue->head = thread;
+    else
+	queue->tail->waitNext = thread;
+    queue->tail = thread;
+}
+
+static Thread *
+WaitRemove (WaitQueue * queue)
+{
+    Thread *thread = queue->head;
+
+    if (thread != NULL)
+      {
+	  queue->head = thread->waitNext;
+	  if (queue->head == NULL)
+	      queue->tail = NULL;
+	  thread->waitNext = NULL;
+      }
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Lock::Lock
+//      Initialize a lock, FREE.
+//
+//      "debugName" is an arbitrary name, useful for debugging.
+//      "inheritPriority" lends the priority of the waiters to the owner.
+//----------------------------------------------------------------------
+
+Lock::Lock (const char *debugName, bool inheritPriority)
 {
+    name = debugName;
+    owner = NULL;
+    waiters.head = waiters.tail = NULL;
+    inherit = inheritPriority;
+    nextHeld = NULL;
+    numAcquires = 0;
+    numContended = 0;
+    maxWaiters = 0;
+    numWaiters = 0;
+    profile = NULL;
 }
 
+//----------------------------------------------------------------------
+// Lock::~Lock
+//      De-allocate a lock.  Nobody may hold it or wait for it.
+//----------------------------------------------------------------------
+
 Lock::~Lock ()
 {
+    ASSERT (owner == NULL && waiters.head == NULL);
 }
+
+//----------------------------------------------------------------------
+// Lock::Acquire
+//      Wait until the lock is FREE, then take it.  A free lock is taken
+//      with interrupts off for a few instructions only; otherwise the
+//      thread sleeps until Release hands the lock over to it.
+//----------------------------------------------------------------------
+
 void
 Lock::Acquire ()
 {
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    ASSERT (owner != currentThread);	// not recursive
+    numAcquires++;
+    if (owner == NULL)
+      {
+	  owner = currentThread;
+	  if (inherit)
+	      Hold ();
+	  if (synchProfiler != NULL)
+	      synchProfiler->Record (&profile, name, -1);
+	  (void) interrupt->SetLevel (oldLevel);
+	  return;
+      }
+
+    long long waitStart = stats->totalTicks;
+
+    numContended++;
+    if (++numWaiters > maxWaiters)
+	maxWaiters = numWaiters;
+    WaitAppend (&waiters, currentThread);
+    currentThread->waitingFor = this;
+    if (inherit)
+	UpdatePriority (owner);
+    while (owner != currentThread)
+	currentThread->Sleep ();
+    if (synchProfiler != NULL)
+	synchProfiler->Record (&profile, name, waitStart);
+    (void) interrupt->SetLevel (oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::Hold, Lock::Unhold
+//      Add the lock to the locks with priority inheritance held by its
+//      owner, take it out.  Interrupts must be disabled.
+//----------------------------------------------------------------------
+
+void
+Lock::Hold ()
+{
+    nextHeld = owner->heldLocks;
+    owner->heldLocks = this;
+}
+
+void
+Lock::Unhold ()
+{
+    Lock **l = &owner->heldLocks;
+
+    while (*l != this)
+	l = &(*l)->nextHeld;
+    *l = nextHeld;
+    nextHeld = NULL;
+}
+
+//----------------------------------------------------------------------
+// Lock::UpdatePriority
+//      Give "thread" the highest (lowest number) of its base priority
+//      and of the priorities of the waiters of the locks it holds.  If
+//      that changes it, do the same for the owner of the lock it waits
+//      for, and so on along the chain.  Interrupts must be disabled.
+//----------------------------------------------------------------------
+
+void
+Lock::UpdatePriority (Thread * thread)
+{
+    while (thread != NULL)
+      {
+	  int newPriority = thread->basePriority;
+
+	  for (Lock * l = thread->heldLocks; l != NULL; l = l->nextHeld)
+	      for (Thread * t = l->waiters.head; t != NULL; t = t->waitNext)
+		  if (t->priority < newPriority)
+		      newPriority = t->priority;
+	  if (newPriority == thread->priority)
+	      return;
+	  (void) scheduler->SetPriority (thread, newPriority);
+
+	  Lock *l = thread->waitingFor;
+	  thread = (l != NULL && l->inherit) ? l->owner : NULL;
+      }
+}
+
+//----------------------------------------------------------------------
+// Lock::HandOver
+//      Give the lock to the first waiter, or set it FREE.  The new owner
+//      inherits the priority of the remaining waiters, and the old one
+//      keeps only what the locks it still holds lend it.  Interrupts
+//      must be disabled.
+//
+//      Return TRUE if the new owner now has a higher priority than the
+//      caller.
+//----------------------------------------------------------------------
+
+bool
+Lock::HandOver ()
+{
+    ASSERT (isHeldByCurrentThread ());
+    if (inherit)
+	Unhold ();
+    owner = WaitRemove (&waiters);
+    if (owner != NULL)
+      {
+	  numWaiters--;
+	  owner->waitingFor = NULL;
+	  if (inherit)
+	    {
+		Hold ();
+		UpdatePriority (owner);	// it stands for the other waiters
+	    }
+	  scheduler->ReadyToRun (owner);
+      }
+    if (!inherit)
+	return FALSE;
+    UpdatePriority (currentThread);
+    return owner != NULL && owner->priority < currentThread->priority;
 }
+
+//----------------------------------------------------------------------
+// Lock::Release
+//      Hand the lock over, and let the new owner run right away if it
+//      inherited a priority higher than the one the caller is left with.
+//----------------------------------------------------------------------
+
 void
 Lock::Release ()
 {
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    if (HandOver () && scheduler->Outranked ())
+	currentThread->Yield ();
+    (void) interrupt->SetLevel (oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SetBasePriority
+//      Change the priority "thread" has of its own.  It keeps the one it
+//      inherits from the locks it holds, if higher.  Interrupts must be
+//      disabled.
+//
+//      Return the previous base priority.
+//----------------------------------------------------------------------
+
+int
+SetBasePriority (Thread * thread, int priority)
+{
+    int old = thread->basePriority;
+
+    ASSERT (interrupt->getLevel () == IntOff);
+    ASSERT (priority >= 0 && priority < NumPriorities);
+    thread->basePriority = priority;
+    Lock::UpdatePriority (thread);
+    return old;
+}
+
+//----------------------------------------------------------------------
+// Lock::isHeldByCurrentThread
+//----------------------------------------------------------------------
+
+bool
+Lock::isHeldByCurrentThread ()
+{
+    return owner == currentThread;
 }
 
+//----------------------------------------------------------------------
+// Lock::Print
+//      Print the contention of the lock, if it was ever acquired.
+//----------------------------------------------------------------------
+
+void
+Lock::Print ()
+{
+    if (numAcquires == 0)
+	return;
+    printf ("Lock \"%s\": %d acquires, %d contended (%.1f%%), "
+	    "at most %d waiters\n", name, numAcquires, numContended,
+	    100.0 * numContended / numAcquires, maxWaiters);
+}
+
+//----------------------------------------------------------------------
+// Condition::Condition
+//      Initialize a condition, nobody waiting.
+//----------------------------------------------------------------------
+
 Condition::Condition (const char *debugName)
 {
+    name = debugName;
+    waiters.head = waiters.tail = NULL;
+    lock = NULL;
 }
 
+//----------------------------------------------------------------------
+// Condition::~Condition
+//      De-allocate a condition.  Nobody may wait on it.
+//----------------------------------------------------------------------
+
 Condition::~Condition ()
 {
+    ASSERT (waiters.head == NULL);
 }
+
+//----------------------------------------------------------------------
+// Condition::Wait
+//      Release "conditionLock" and sleep until signaled, atomically
+//      since interrupts are off, then take the lock again.  Mesa
+//      semantics: the condition must be checked again by the caller.
+//----------------------------------------------------------------------
+
 void
 Condition::Wait (Lock * conditionLock)
 {
-    ASSERT (FALSE);
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    ASSERT (conditionLock->isHeldByCurrentThread ());
+    ASSERT (lock == NULL || lock == conditionLock);
+    lock = conditionLock;
+    WaitAppend (&waiters, currentThread);
+    (void) conditionLock->HandOver ();	// no Yield, it is on our queue
+    currentThread->Sleep ();
+    conditionLock->Acquire ();
+    (void) interrupt->SetLevel (oldLevel);
 }
 
+//----------------------------------------------------------------------
+// Condition::Signal, Condition::Broadcast
+//      Wake up the first thread waiting on the condition, or all of
+//      them.  They get "conditionLock" back in Wait, after the caller
+//      releases it.
+//----------------------------------------------------------------------
+
 void
 Condition::Signal (Lock * conditionLock)
 {
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+    Thread *thread;
+
+    ASSERT (conditionLock->isHeldByCurrentThread ());
+    ASSERT (lock == NULL || lock == conditionLock);
+    if ((thread = WaitRemove (&waiters)) != NULL)
+	scheduler->ReadyToRun (thread);
+    (void) interrupt->SetLevel (oldLevel);
 }
+
 void
 Condition::Broadcast (Lock * conditionLock)
 {
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+    Thread *thread;
+
+    ASSERT (conditionLock->isHeldByCurrentThread ());
+    ASSERT (lock == NULL || lock == conditionLock);
+    while ((thread = WaitRemove (&waiters)) != NULL)
+	scheduler->ReadyToRun (thread);
+    (void) interrupt->SetLevel (oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+//      Initialize a reader-writer lock, FREE.
+//
+//      "debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock (const char *debugName)
+{
+    name = debugName;
+    readers = 0;
+    writer = NULL;
+    readWaiters.head = readWaiters.tail = NULL;
+    writeWaiters.head = writeWaiters.tail = NULL;
+    numReads = numWrites = 0;
+    numReadWaits = numWriteWaits = 0;
+    maxReaders = 0;
+    profile = NULL;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+//      De-allocate a reader-writer lock.  Nobody may hold it or wait
+//      for it.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock ()
+{
+    ASSERT (readers == 0 && writer == NULL);
+    ASSERT (readWaiters.head == NULL && writeWaiters.head == NULL);
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead
+//      Wait until no writer holds or waits for the lock, then share it.
+//      A reader put to sleep is woken up by ReleaseWrite, which counts
+//      it as a reader already.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireRead ()
+{
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    long long waitStart = -1;
+
+    ASSERT (writer != currentThread);
+    numReads++;
+    if (writer == NULL && writeWaiters.head == NULL)
+	readers++;
+    else
+      {
+	  waitStart = stats->totalTicks;
+	  numReadWaits++;
+	  WaitAppend (&readWaiters, currentThread);
+	  currentThread->Sleep ();
+	  ASSERT (writer == NULL && readers > 0);
+      }
+    if (readers > maxReaders)
+	maxReaders = readers;
+    if (synchProfiler != NULL)
+	synchProfiler->Record (&profile, name, waitStart);
+    (void) interrupt->SetLevel (oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseRead
+//      Stop sharing the lock; the last reader hands it over to the
+//      first writer waiting.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseRead ()
+{
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    ASSERT (readers > 0 && writer == NULL);
+    if (--readers == 0 && (writer = WaitRemove (&writeWaiters)) != NULL)
+	scheduler->ReadyToRun (writer);
+    (void) interrupt->SetLevel (oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite
+//      Wait until nobody holds the lock, then hold it alone.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireWrite ()
+{
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    long long waitStart = -1;
+
+    ASSERT (writer != currentThread);
+    numWrites++;
+    if (writer == NULL && readers == 0)
+	writer = currentThread;
+    else
+      {
+	  waitStart = stats->totalTicks;
+	  numWriteWaits++;
+	  WaitAppend (&writeWaiters, currentThread);
+	  while (writer != currentThread)
+	      currentThread->Sleep ();
+      }
+    if (synchProfiler != NULL)
+	synchProfiler->Record (&profile, name, waitStart);
+    (void) interrupt->SetLevel (oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::ReleaseWrite
+//      Give the lock to all the readers waiting, as a batch, or if there
+//      are none, to the first writer waiting.
+//----------------------------------------------------------------------
+
+void
+RWLock::ReleaseWrite ()
+{
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+    Thread *thread;
+
+    ASSERT (isWriteHeldByCurrentThread ());
+    writer = NULL;
+    if (readWaiters.head != NULL)
+	while ((thread = WaitRemove (&readWaiters)) != NULL)
+	  {
+	      readers++;
+	      scheduler->ReadyToRun (thread);
+	  }
+    else if ((writer = WaitRemove (&writeWaiters)) != NULL)
+	scheduler->ReadyToRun (writer);
+    (void) interrupt->SetLevel (oldLevel);
+}
+
+//----------------------------------------------------------------------
+// RWLock::isWriteHeldByCurrentThread
+//----------------------------------------------------------------------
+
+bool
+RWLock::isWriteHeldByCurrentThread ()
+{
+    return writer == currentThread;
+}
+
+//----------------------------------------------------------------------
+// RWLock::Print
+//      Print the contention of the lock, if it was ever acquired.
+//----------------------------------------------------------------------
+
+void
+RWLock::Print ()
+{
+    if (numReads + numWrites == 0)
+	return;
+    printf ("RWLock \"%s\": %d reads, %d waited, at most %d together; "
+	    "%d writes, %d waited\n", name, numReads, numReadWaits,
+	    maxReaders, numWrites, numWriteWaits);
+}
+
+//----------------------------------------------------------------------
+// SynchProfiler::SynchProfiler
+//      Start recording the contention of the synchronization objects.
+//
+//      "top" is the number of names printed at halt.
+//----------------------------------------------------------------------
+
+SynchProfiler::SynchProfiler (int top)
+{
+    for (int i = 0; i < ProfileBuckets; i++)
+	buckets[i] = NULL;
+    numProfiles = 0;
+    topN = top;
+}
+
+//----------------------------------------------------------------------
+// SynchProfiler::~SynchProfiler
+//----------------------------------------------------------------------
+
+SynchProfiler::~SynchProfiler ()
+{
+    for (int i = 0; i < ProfileBuckets; i++)
+	while (buckets[i] != NULL)
+	  {
+	      SynchProfile *p = buckets[i];
+
+	      buckets[i] = p->next;
+	      delete p;
+	  }
+}
+
+//----------------------------------------------------------------------
+// SynchProfiler::Find
+//      Return the profile of the objects named "name", creating it the
+//      first time.  Names are copied, since some are built on the fly.
+//----------------------------------------------------------------------
+
+SynchProfile *
+SynchProfiler::Find (const char *name)
+{
+    unsigned hash = 0;
+    SynchProfile *p;
+
+    if (name == NULL)
+	name = "(unnamed)";
+    for (const char *c = name; *c != '\0' && c - name < ProfileNameLen - 1;
+	 c++)
+	hash = hash * 31 + (unsigned char) *c;
+    hash %= ProfileBuckets;
+    for (p = buckets[hash]; p != NULL; p = p->next)
+	if (!strncmp (p->name, name, ProfileNameLen - 1))
+	    return p;
+
+    p = new SynchProfile;
+    strncpy (p->name, name, ProfileNameLen - 1);
+    p->name[ProfileNameLen - 1] = '\0';
+    p->acquires = p->contended = 0;
+    p->totalWait = p->maxWait = 0;
+    for (int i = 0; i < ProfileWaiters; i++)
+      {
+	  p->waiterNames[i][0] = '\0';
+	  p->waiterTicks[i] = -1;
+      }
+    p->next = buckets[hash];
+    buckets[hash] = p;
+    numProfiles++;
+    return p;
+}
+
+//----------------------------------------------------------------------
+// SynchProfiler::Record
+//      Count an acquire of the object named "name", by the current
+//      thread.  "*profile" caches the profile of the object, found on
+//      its first acquire.  Interrupts must be disabled.
+//
+//      "waitStart" is when the thread started to wait, -1 if it did not.
+//----------------------------------------------------------------------
+
+void
+SynchProfiler::Record (SynchProfile ** profile, const char *name,
+		       long long waitStart)
+{
+    SynchProfile *p = *profile;
+
+    if (p == NULL)
+	p = *profile = Find (name);
+    p->acquires++;
+    if (waitStart < 0)
+	return;
+
+    long long wait = stats->totalTicks - waitStart;
+    int shortest = 0;
+
+    p->contended++;
+    p->totalWait += wait;
+    if (wait > p->maxWait)
+	p->maxWait = wait;
+    for (int i = 1; i < ProfileWaiters; i++)
+	if (p->waiterTicks[i] < p->waiterTicks[shortest])
+	    shortest = i;
+    if (wait > p->waiterTicks[shortest])
+      {
+	  strncpy (p->waiterNames[shortest], currentThread->getName (),
+		   ProfileNameLen - 1);
+	  p->waiterNames[shortest][ProfileNameLen - 1] = '\0';
+	  p->waiterTicks[shortest] = wait;
+      }
+}
+
+//----------------------------------------------------------------------
+// SynchProfiler::Print
+//      Print the "topN" names most waited for, by total wait, with the
+//      threads which waited longest on each.
+//----------------------------------------------------------------------
+
+void
+SynchProfiler::Print ()
+{
+    SynchProfile **sorted = new SynchProfile *[numProfiles];
+    int m = 0, n;
+
+    for (int i = 0; i < ProfileBuckets; i++)
+	for (SynchProfile * p = buckets[i]; p != NULL; p = p->next)
+	    if (p->contended > 0)
+		sorted[m++] = p;
+    n = topN < m ? topN : m;
+    printf ("Synchronization profile, %d of %d names by total wait:\n",
+	    n, m);
+    for (int i = 0; i < n; i++)
+      {
+	  int best = i;		// selection of the top ones only
+
+	  for (int j = i + 1; j < m; j++)
+	      if (sorted[j]->totalWait > sorted[best]->totalWait)
+		  best = j;
+	  SynchProfile *p = sorted[best];
+
+	  sorted[best] = sorted[i];
+	  sorted[i] = p;
+	  printf ("  \"%s\": %d acquires, %d waited (%.1f%%), %lld ticks, "
+		  "max %lld\n", p->name, p->acquires, p->contended,
+		  100.0 * p->contended / p->acquires, p->totalWait,
+		  p->maxWait);
+	  printf ("    longest waiters:");
+	  for (int w = 0; w < ProfileWaiters; w++)
+	      if (p->waiterTicks[w] >= 0)
+		  printf (" \"%s\" %lld", p->waiterNames[w], p->waiterTicks[w]);
+	  printf ("\n");
+      }
+    delete [] sorted;
 }
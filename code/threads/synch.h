@@ -1,11 +1,8 @@
 // synch.h 
 //      Data structures for synchronizing threads.
 //
-//      Three kinds of synchronization are defined here: semaphores,
-//      locks, and condition variables.  The implementation for
-//      semaphores is given; for the latter two, only the procedure
-//      interface is given -- they are to be implemented as part of 
-//      the first assignment.
+//      Four kinds of synchronization are defined here: semaphores,
+//      locks, condition variables, and reader-writer locks.
 //
 //      Note that all the synchronization objects take a "name" as
 //      part of the initialization.  This is solely for debugging purposes.
@@ -21,6 +18,58 @@
 // #include "thread.h"
 #include "list.h"
 
+class Thread;
+
+#define ProfileBuckets	64	// hash table of the profiler
+#define ProfileNameLen	32	// longest name kept, with the '\0'
+#define ProfileWaiters	3	// longest waits kept for each name
+
+// The contention of all the synchronization objects of one name, for
+// instance all the "ThreadJoin" semaphores, as recorded by the
+// SynchProfiler.
+struct SynchProfile
+{
+    char name[ProfileNameLen];
+    int acquires;		// P, Acquire, AcquireRead and AcquireWrite
+    int contended;		// the ones which had to wait
+    long long totalWait;	// ticks spent waiting
+    long long maxWait;
+    char waiterNames[ProfileWaiters][ProfileNameLen];	// the threads
+    long long waiterTicks[ProfileWaiters];	// which waited longest
+    SynchProfile *next;		// in its hash bucket
+};
+
+// Records how often semaphores and locks make threads wait, and for
+// how long.  It only exists with -lp: otherwise "synchProfiler" is NULL
+// and each operation only pays for that test.
+
+class SynchProfiler
+{
+  public:
+    SynchProfiler (int top);	// print the "top" most waited for
+    ~SynchProfiler ();
+
+    void Record (SynchProfile ** profile, const char *name,
+		 long long waitStart);	// An acquire which started to
+    // wait at "waitStart", -1 if it did not
+    void Print ();		// Called at halt
+
+  private:
+    SynchProfile *Find (const char *name);	// Created if need be
+    SynchProfile *buckets[ProfileBuckets];
+    int numProfiles;
+    int topN;
+};
+
+// A FIFO of blocked threads, linked through the threads themselves, so
+// that waiting allocates nothing: a thread waits on one lock or
+// condition at a time.
+struct WaitQueue
+{
+    Thread *head;
+    Thread *tail;
+};
+
 // The following class defines a "semaphore" whose value is a non-negative
 // integer.  The semaphore has only two operations P() and V():
 //
@@ -53,6 +102,7 @@ class Semaphore
     const char *name;		// useful for debugging
     int value;			// semaphore value, always >= 0
     List *queue;		// threads waiting in P() for the value to be > 0
+    SynchProfile *profile;	// its contention, when profiling
 };
 
 // The following class defines a "lock".  A lock can be BUSY or FREE.
@@ -66,11 +116,19 @@ class Semaphore
 // In addition, by convention, only the thread that acquired the lock
 // may release it.  As with semaphores, you can't read the lock value
 // (because the value might change immediately after you read it).  
+//
+// Acquiring a free lock does not involve the scheduler.  Release hands
+// the lock over to the first waiter, which therefore cannot be overtaken.
+// With priority inheritance, the owner runs with the priority of the
+// most urgent waiter of the locks it holds (PRIORITY policy), or with
+// its own base priority if that is higher.  Release yields to the new
+// owner when it then outranks the caller.
 
 class Lock
 {
   public:
-    Lock (const char *debugName);	// initialize lock to be FREE
+    Lock (const char *debugName, bool inheritPriority = FALSE);
+    				// initialize lock to be FREE
      ~Lock ();			// deallocate lock
     const char *getName ()
     {
@@ -85,11 +143,33 @@ class Lock
     // checking in Release, and in
     // Condition variable ops below.
 
+    void Print ();		// Acquires and how many had to wait
+
+    static void UpdatePriority (Thread * thread);	// recompute the
+    // inherited priority of "thread" and of the owners it waits for
+
   private:
+    friend class Condition;	// Wait releases the lock with HandOver
     const char *name;		// for debugging
-    // plus some other stuff you'll need to define
+    Thread *owner;		// NULL if the lock is FREE
+    WaitQueue waiters;		// threads blocked in Acquire
+    bool inherit;		// lend the waiters' priority to the owner
+    Lock *nextHeld;		// next lock with inheritance held by
+    				// the owner
+    int numAcquires;
+    int numContended;		// acquires which had to wait
+    int maxWaiters;		// longest the wait queue has been
+    int numWaiters;
+    SynchProfile *profile;	// its contention, when profiling
+    bool HandOver ();		// Release, without yielding
+    void Hold ();		// add to the locks of the owner
+    void Unhold ();		// remove from the locks of the owner
 };
 
+extern int SetBasePriority (Thread * thread, int priority);
+				// change the priority of "thread" when
+				// it inherits none, return the old one
+
 // The following class defines a "condition variable".  A condition
 // variable does not have a value, but threads may be queued, waiting
 // on the variable.  These are only operations on a condition variable: 
@@ -143,6 +223,56 @@ class Condition
 
   private:
     const char *name;
-    // plus some other stuff you'll need to define
+    WaitQueue waiters;		// threads blocked in Wait
+    Lock *lock;			// the one used with it, NULL until the
+    // first Wait
 };
+
+// The following class defines a "reader-writer lock": any number of
+// readers may hold it together, or a single writer.
+//
+//      AcquireRead/ReleaseRead -- share the lock with the other readers
+//
+//      AcquireWrite/ReleaseWrite -- hold the lock alone
+//
+// Writers are preferred: once a writer waits, new readers wait behind
+// it, so that a stream of readers cannot starve it.  When a writer
+// releases the lock, all the readers waiting get it at once, before the
+// next writer, so that readers are not starved either.  As with Lock,
+// the lock is handed over to the threads woken up, and taking a free
+// lock does not involve the scheduler.
+
+class RWLock
+{
+  public:
+    RWLock (const char *debugName);	// initialize lock to be FREE
+     ~RWLock ();		// deallocate lock
+    const char *getName ()
+    {
+	return name;
+    }				// debugging assist
+
+    void AcquireRead ();
+    void ReleaseRead ();
+    void AcquireWrite ();
+    void ReleaseWrite ();
+
+    bool isWriteHeldByCurrentThread ();
+
+    void Print ();		// Acquires and how many had to wait
+
+  private:
+    const char *name;		// for debugging
+    int readers;		// threads holding the lock for reading
+    Thread *writer;		// thread holding it for writing, if any
+    WaitQueue readWaiters;	// threads blocked in AcquireRead
+    WaitQueue writeWaiters;	// and in AcquireWrite
+    int numReads;		// AcquireRead calls
+    int numWrites;		// AcquireWrite calls
+    int numReadWaits;		// the ones which had to wait
+    int numWriteWaits;
+    int maxReaders;		// most readers holding the lock together
+    SynchProfile *profile;	// its contention, when profiling
+};
+
 #endif // SYNCH_H
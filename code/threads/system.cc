@@ -18,6 +18,7 @@ Interrupt *interrupt;		// interrupt status
 Statistics *stats;		// performance metrics
 Timer *timer;			// the hardware timer device,
 					// for invoking context switches
+SynchProfiler *synchProfiler;	// NULL unless -lp
 
 #ifdef FILESYS_NEEDED
 FileSystem *fileSystem;
@@ -32,6 +33,14 @@ SynchDisk *synchDisk;
 Machine *machine;		// user program memory and registers
 SynchConsole *synchconsole;
 FrameProvider *frameProvider;
+PageStore *pageStore;
+LoadControl *loadControl;
+VmStats *vmStats;
+ShmTable *shmTable;
+FutexTable *futexTable;
+bool sparsePageTables = TRUE;
+int faultAroundPages = 4;
+int prefetchWindow = 16;
 int numProc;
 void MajNbProc(int n);
 int GetNbProc();
@@ -64,13 +73,39 @@ extern void Cleanup ();
 //      "dummy" is because every interrupt handler takes one argument,
 //              whether it needs it or not.
 //----------------------------------------------------------------------
+static bool timeSlicing;		// preempt threads on timer interrupts
+static bool sampleWorkingSets;	// feed the load control
+
 static void
 TimerInterruptHandler (int dummy)
 {
-    if (interrupt->getStatus () != IdleMode)
+#ifdef USER_PROGRAM
+    if (sampleWorkingSets && loadControl != NULL)
+	loadControl->Sample ();
+#endif
+    if (timeSlicing && interrupt->getStatus () != IdleMode
+	&& scheduler->ShouldPreempt ())
 	interrupt->YieldOnReturn ();
 }
 
+//----------------------------------------------------------------------
+// EnableTimeSlicing
+//      Preempt threads on timer interrupts from now on, starting the
+//      timer if it is not running yet: called when a thread sets its own
+//      quantum under FIFO, which otherwise never preempts.
+//----------------------------------------------------------------------
+
+void
+EnableTimeSlicing ()
+{
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    timeSlicing = TRUE;
+    if (timer == NULL)
+	timer = new Timer (TimerInterruptHandler, 0, FALSE);
+    (void) interrupt->SetLevel (oldLevel);
+}
+
 //----------------------------------------------------------------------
 // Initialize
 //      Initialize Nachos global data structures.  Interpret command
@@ -87,9 +122,21 @@ Initialize (int argc, char **argv)
     int argCount;
     const char *debugArgs = "";
     bool randomYield = FALSE;
+    SchedPolicy policy = POLICY_FIFO;
+    int schedLevels = 1;	// MLFQ priority levels
+    int quantum = 0;		// MLFQ quantum of the top level, or
+    				// time slice of the other policies,
+    				// 0 for the default
+    int gangWindow = 0;		// 0: no gang scheduling
+    int profileTop = 0;		// -lp: names of the synchronization
+    				// profile printed at halt
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool randomFrames = FALSE;	// hand out physical frames at random
+    int frameLimit = 0;		// max frames per process, 0 = no limit
+    bool paging = FALSE;	// evict pages when memory is full
+    int poolSize = 32768;	// bytes of compressed evicted pages
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -120,9 +167,72 @@ Initialize (int argc, char **argv)
 		randomYield = TRUE;
 		argCount = 2;
 	    }
+	  else if (!strcmp (*argv, "-mlfq"))
+	    {
+		ASSERT (argc > 1);
+		policy = POLICY_MLFQ;
+		schedLevels = atoi (*(argv + 1));
+		argCount = 2;
+	    }
+	  else if (!strcmp (*argv, "-prio"))
+	      policy = POLICY_PRIORITY;
+	  else if (!strcmp (*argv, "-stride"))
+	      policy = POLICY_STRIDE;
+	  else if (!strcmp (*argv, "-lottery"))
+	      policy = POLICY_LOTTERY;
+	  else if (!strcmp (*argv, "-quantum"))
+	    {
+		ASSERT (argc > 1);
+		quantum = atoi (*(argv + 1));
+		argCount = 2;
+	    }
+	  else if (!strcmp (*argv, "-gang"))
+	    {
+		ASSERT (argc > 1);
+		gangWindow = atoi (*(argv + 1));
+		argCount = 2;
+	    }
+	  else if (!strcmp (*argv, "-lp"))
+	    {
+		ASSERT (argc > 1);
+		profileTop = atoi (*(argv + 1));
+		argCount = 2;
+	    }
 #ifdef USER_PROGRAM
 	  if (!strcmp (*argv, "-s"))
 	      debugUserProg = TRUE;
+	  else if (!strcmp (*argv, "-rp"))
+	      randomFrames = TRUE;
+	  else if (!strcmp (*argv, "-spt"))
+	      sparsePageTables = TRUE;
+	  else if (!strcmp (*argv, "-lpt"))
+	      sparsePageTables = FALSE;
+	  else if (!strcmp (*argv, "-ml"))
+	    {
+		ASSERT (argc > 1);
+		frameLimit = atoi (*(argv + 1));
+		argCount = 2;
+	    }
+	  else if (!strcmp (*argv, "-vm"))
+	      paging = TRUE;
+	  else if (!strcmp (*argv, "-zp"))
+	    {
+		ASSERT (argc > 1);
+		poolSize = atoi (*(argv + 1));
+		argCount = 2;
+	    }
+	  else if (!strcmp (*argv, "-fa"))
+	    {
+		ASSERT (argc > 1);
+		faultAroundPages = atoi (*(argv + 1));
+		argCount = 2;
+	    }
+	  else if (!strcmp (*argv, "-pf"))
+	    {
+		ASSERT (argc > 1);
+		prefetchWindow = atoi (*(argv + 1));
+		argCount = 2;
+	    }
 #endif
 #ifdef FILESYS_NEEDED
 	  if (!strcmp (*argv, "-f"))
@@ -147,8 +257,16 @@ Initialize (int argc, char **argv)
     DebugInit (debugArgs);	// initialize DEBUG messages
     stats = new Statistics ();	// collect statistics
     interrupt = new Interrupt;	// start up interrupt handling
-    scheduler = new Scheduler ();	// initialize the ready queue
-    if (randomYield)		// start the timer (if needed)
+    scheduler = new Scheduler (policy, schedLevels, quantum, gangWindow);
+    				// initialize the ready queues
+    // start the timer (if needed), paging uses it to sample the working
+    // sets of the user processes, the policies other than FIFO, or FIFO
+    // given a quantum, to enforce the quanta
+    timeSlicing = randomYield || policy != POLICY_FIFO || quantum > 0;
+#ifdef USER_PROGRAM
+    sampleWorkingSets = paging;
+#endif
+    if (timeSlicing || sampleWorkingSets)
 	timer = new Timer (TimerInterruptHandler, 0, randomYield);
 
     threadToBeDestroyed = NULL;
@@ -158,6 +276,9 @@ Initialize (int argc, char **argv)
     // object to save its state. 
     currentThread = new Thread ("main");
     currentThread->setStatus (RUNNING);
+    scheduler->SetPriority (currentThread, DefaultPriority);
+    if (profileTop > 0)
+	synchProfiler = new SynchProfiler (profileTop);
 
     interrupt->Enable ();
     CallOnUserAbort (Cleanup);	// if user hits ctl-C
@@ -166,6 +287,14 @@ Initialize (int argc, char **argv)
     machine = new Machine (debugUserProg);	// this must come first
 	synchconsole = new SynchConsole(NULL,NULL);
 	frameProvider = new FrameProvider(NumPhysPages);
+	frameProvider->SetRandomPlacement(randomFrames);
+	frameProvider->SetDefaultFrameLimit(frameLimit);
+	frameProvider->SetPaging(paging);
+	pageStore = new PageStore(poolSize);
+	loadControl = new LoadControl();
+	vmStats = new VmStats();
+	shmTable = new ShmTable();
+	futexTable = new FutexTable();
 	numProc = 0;
 #endif
 
@@ -217,6 +346,7 @@ Cleanup ()
 
     delete timer;
     delete scheduler;
+    delete synchProfiler;
     delete interrupt;
 
     Exit (0);
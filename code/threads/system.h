@@ -15,6 +15,7 @@
 #include "interrupt.h"
 #include "stats.h"
 #include "timer.h"
+#include "synch.h"
 
 #define MAX_STRING_SIZE 100
 
@@ -26,6 +27,7 @@ extern void Initialize (int argc, char **argv);	// Initialization,
 						// called before anything else
 extern void Cleanup ();		// Cleanup, called when
 						// Nachos is done.
+extern void EnableTimeSlicing ();	// Start preempting threads
 
 extern Thread *currentThread;	// the thread holding the CPU
 extern Thread *threadToBeDestroyed;	// the thread that just finished
@@ -33,13 +35,28 @@ extern Scheduler *scheduler;	// the ready list
 extern Interrupt *interrupt;	// interrupt status
 extern Statistics *stats;	// performance metrics
 extern Timer *timer;		// the hardware alarm clock
+extern SynchProfiler *synchProfiler;	// contention of the semaphores
+					// and locks, NULL unless -lp
 
 #ifdef USER_PROGRAM
 #include "machine.h"
 #include "synchconsole.h"
+#include "pagestore.h"
+#include "loadcontrol.h"
+#include "vmstats.h"
+#include "shm.h"
+#include "futex.h"
 extern Machine *machine;	// user program memory and registers
 extern SynchConsole *synchconsole;
 extern FrameProvider *frameProvider;
+extern PageStore *pageStore;	// where evicted pages go
+extern LoadControl *loadControl;	// admission and thrashing control
+extern VmStats *vmStats;	// virtual memory telemetry of the machine
+extern ShmTable *shmTable;	// shared memory segments
+extern FutexTable *futexTable;	// wait queues of user synchronization
+extern bool sparsePageTables;	// use two-level page tables
+extern int faultAroundPages;	// pages loaded together on a page fault
+extern int prefetchWindow;	// max pages read ahead of a sequential scan
 #endif
 
 #ifdef FILESYS_NEEDED		// FILESYS or FILESYS_STUB
@@ -38,10 +38,26 @@ Thread::Thread (const char *threadName)
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
+    level = 0;
+    priority = basePriority = DefaultPriority;
+    heldLocks = NULL;
+    timeSlice = 0;
+    readyNext = readyPrev = NULL;
+    waitNext = NULL;
+    waitingFor = NULL;
+    rtBudget = rtPeriod = rtRemaining = 0;
+    rtDeadline = 0;
+    epoch = 0;
+    dispatchedAt = 0;
+    userTicks = systemTicks = waitTicks = 0;
+    userMark = stats->userTicks;
+    systemMark = stats->systemTicks;
+    readySince = 0;
+    scheduler->AddThread (this);
 #ifdef USER_PROGRAM
     space = NULL;
-    dependentTID = -1;
-    initStackReg = 0;
+    tid = 0;
+    stackSlot = -1;
     // FBT: Need to initialize special registers of simulator to 0
     // in particular LoadReg or it could crash when switching
     // user threads.
@@ -67,6 +83,7 @@ Thread::~Thread ()
     DEBUG ('t', "Deleting thread \"%s\"\n", name);
 
     ASSERT (this != currentThread);
+    scheduler->RemoveThread (this);
     if (stack != NULL)
 	DeallocBoundedArray ((char *) stack, StackSize * sizeof (int));
 }
@@ -98,6 +115,9 @@ Thread::Fork (VoidFunctionPtr func, int arg)
 	   name, (int) func, arg);
 
     StackAllocate (func, arg);
+    priority = basePriority = currentThread->basePriority;	// inherited
+    // from the creator, without the priority it borrows from its locks
+    timeSlice = currentThread->timeSlice;
 
 #ifdef USER_PROGRAM
 
@@ -120,6 +140,8 @@ Thread::Fork (VoidFunctionPtr func, int arg)
 void Thread::ForkExec(VoidFunctionPtr func, int arg) {
 
     StackAllocate(func, arg);
+    priority = basePriority = currentThread->basePriority;
+    timeSlice = currentThread->timeSlice;
 
     // The modification of the space is a problem when we try to do ForkExec
     IntStatus oldLevel = interrupt->SetLevel(IntOff);
@@ -177,6 +199,15 @@ Thread::Finish ()
     ASSERT (this == currentThread);
 
     DEBUG ('t', "Finishing thread \"%s\"\n", getName ());
+    if (rtPeriod > 0)
+	scheduler->SetRealTime (this, 0, 0);	// give its share back
+#ifdef USER_PROGRAM
+    if (space != NULL)
+      {				// its CPU time goes to the process
+	  scheduler->Account (this);
+	  space->AddCpuTime (this);
+      }
+#endif
 
     // LB: Be careful to guarantee that no thread to be destroyed 
     // is ever lost 
@@ -313,10 +344,10 @@ SetupThreadState ()
 
   if (currentThread->space != NULL)
     {				// if there is an address space
-      // LB: Actually, the user state is void at that time. Keep this
-      // action for consistency with the Scheduler::Run function
-      currentThread->RestoreUserState ();	// to restore, do it.
-      currentThread->space->RestoreState ();
+      // LB: Actually, the user state is void at that time, unless the
+      // creator of a user thread set it (see do_UserThreadCreateN).
+      // Keep this action for consistency with the Scheduler::Run function
+      scheduler->LoadUserState (currentThread);	// to restore, do it.
     }
 
 #endif // USER_PROGRAM
@@ -390,6 +421,19 @@ Thread::StackAllocate (VoidFunctionPtr func, int arg)
 #ifdef USER_PROGRAM
 #include "machine.h"
 
+//----------------------------------------------------------------------
+// Thread::SetUserRegister
+//      Set a user-level register of a thread which has not run yet:
+//      they are loaded into the machine when it starts.
+//----------------------------------------------------------------------
+
+void
+Thread::SetUserRegister (int num, int value)
+{
+    ASSERT (num >= 0 && num < NumTotalRegs);
+    userRegisters[num] = value;
+}
+
 //----------------------------------------------------------------------
 // Thread::SaveUserState
 //      Save the CPU state of a user program on a context switch.
@@ -420,6 +464,7 @@ Thread::RestoreUserState ()
 {
     for (int i = 0; i < NumTotalRegs; i++)
 	machine->WriteRegister (i, userRegisters[i]);
+    machine->llAddr = -1;	// another thread may have run since its LL
 }
 #endif
 
@@ -45,6 +45,8 @@
 #include "addrspace.h"
 #endif
 
+class Lock;
+
 // CPU register state to be saved on context switch.  
 // The SPARC and MIPS only need 10 registers, but the Snake needs 18.
 // For simplicity, this is just the max over all architectures.
@@ -56,6 +58,10 @@
 #define StackSize	(4 * 1024)	// in words
 
 
+// Scheduling priorities, 0 is the highest
+#define NumPriorities	64
+#define DefaultPriority	32
+
 // Thread state
 enum ThreadStatus
 { JUST_CREATED, RUNNING, READY, BLOCKED };
@@ -105,6 +111,10 @@ class Thread
     {
 	status = st;
     }
+    ThreadStatus getStatus ()
+    {
+	return (status);
+    }
     const char *getName ()
     {
 	return (name);
@@ -114,8 +124,40 @@ class Thread
 	printf ("%s, ", name);
     }
 
-    int initStackReg;
-    int dependentTID;
+    int level;			// scheduling priority level, 0 is the
+    				// highest
+    int priority;		// fixed priority, PRIORITY policy
+    int basePriority;		// priority when it inherits none
+    Lock *heldLocks;		// locks with priority inheritance it
+    				// holds
+    int timeSlice;		// ticks it may run before being
+    				// preempted, 0 for the quantum of
+    				// the policy
+    Thread *readyNext;		// links in the ready list of its level
+    Thread *readyPrev;
+    Thread *waitNext;		// link in the wait queue of a lock or
+    				// a condition
+    Lock *waitingFor;		// lock it is blocked on, if any
+    int rtBudget;		// real-time class: ticks of CPU per
+    int rtPeriod;		// period, 0 for best-effort threads
+    int rtRemaining;		// budget left in the current period
+    long long rtDeadline;	// end of the current period
+    int epoch;			// scheduler boosts seen by the thread
+    long long dispatchedAt;	// time the thread last got the CPU
+
+    // CPU accounting, brought up to date at each context switch
+    long long userTicks;	// user instructions executed
+    long long systemTicks;	// time in the kernel, interrupts included
+    long long waitTicks;	// time spent ready, waiting for the CPU
+    long long userMark;		// stats->userTicks and systemTicks when
+    long long systemMark;	// last brought up to date
+    long long readySince;	// time it was last put on a ready list
+    Thread *allNext;		// links in the list of all the threads
+    Thread *allPrev;
+
+    int tid;			// user thread id, 0 for the main thread
+    int stackSlot;		// user stack of the thread, -1 for the
+    				// main thread
 
   protected: // SHIVA: changing the access specifier inorder to give access to the stack to child UserThread class
     // some of the private data for this class is listed above
@@ -140,6 +182,8 @@ class Thread
   public:
     void SaveUserState ();	// save user-level register state
     void RestoreUserState ();	// restore user-level register state
+    void SetUserRegister (int num, int value);	// initial user state,
+    				// before the thread first runs
 
     AddrSpace *space;		// User code this thread is running.
 #endif
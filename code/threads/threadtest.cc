@@ -11,6 +11,7 @@
 
 #include "copyright.h"
 #include "system.h"
+#include "synch.h"
 
 //----------------------------------------------------------------------
 // SimpleThread
@@ -33,10 +34,290 @@ SimpleThread (int which)
       }
 }
 
+//----------------------------------------------------------------------
+// Producer, Consumer
+//      Bounded buffer guarded by a Lock, with a Condition for each side,
+//      for LockTest.
+//----------------------------------------------------------------------
+
+#define BufferSize	4
+#define Items		20
+
+static Lock *bufferLock;
+static Condition *notFull, *notEmpty;
+static Semaphore *consumersDone;
+static int buffer[BufferSize];
+static int count, in, out;
+static int consumed;
+
+static void
+Producer (int which)
+{
+    for (int i = 1; i <= Items; i++)
+      {
+	  bufferLock->Acquire ();
+	  while (count == BufferSize)
+	      notFull->Wait (bufferLock);
+	  buffer[in] = i;
+	  in = (in + 1) % BufferSize;
+	  count++;
+	  notEmpty->Signal (bufferLock);
+	  bufferLock->Release ();
+	  currentThread->Yield ();
+      }
+}
+
+static void
+Consumer (int which)
+{
+    for (int i = 0; i < Items; i++)
+      {
+	  bufferLock->Acquire ();
+	  while (count == 0)
+	      notEmpty->Wait (bufferLock);
+	  consumed += buffer[out];
+	  out = (out + 1) % BufferSize;
+	  count--;
+	  notFull->Signal (bufferLock);
+	  bufferLock->Release ();
+      }
+    consumersDone->V ();
+}
+
+//----------------------------------------------------------------------
+// LockTest
+//      Two producers and two consumers share a bounded buffer; every
+//      item produced must be consumed exactly once.
+//----------------------------------------------------------------------
+
+void
+LockTest ()
+{
+    bufferLock = new Lock ("buffer lock");
+    notFull = new Condition ("buffer not full");
+    notEmpty = new Condition ("buffer not empty");
+    consumersDone = new Semaphore ("consumers done", 0);
+
+    for (int i = 0; i < 2; i++)
+      {
+	  (new Thread ("producer"))->Fork (Producer, i);
+	  (new Thread ("consumer"))->Fork (Consumer, i);
+      }
+    for (int i = 0; i < 2; i++)
+	consumersDone->P ();
+    ASSERT (count == 0 && consumed == 2 * Items * (Items + 1) / 2);
+    printf ("*** lock test: %d items consumed\n", 2 * Items);
+    bufferLock->Print ();
+}
+
+//----------------------------------------------------------------------
+// Reader, Writer
+//      Threads of RWLockTest.  A thread counts itself as arrived and
+//      blocks on the lock with interrupts off, so that the main thread
+//      knows it is queued once it sees it arrived.
+//----------------------------------------------------------------------
+
+static RWLock *rwLock;
+static Semaphore *rwDone;
+static int rwArrived, rwInside, rwMaxInside, rwReadsDone;
+static bool firstWriterDone;
+
+static void
+Reader (int which)
+{
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    rwArrived++;
+    rwLock->AcquireRead ();
+    (void) interrupt->SetLevel (oldLevel);
+    ASSERT (firstWriterDone);	// it waited behind the writer
+    if (++rwInside > rwMaxInside)
+	rwMaxInside = rwInside;
+    currentThread->Yield ();	// the other reader of the batch gets in
+    rwInside--;
+    rwReadsDone++;
+    rwLock->ReleaseRead ();
+    rwDone->V ();
+}
+
+static void
+Writer (int which)
+{
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    rwArrived++;
+    rwLock->AcquireWrite ();
+    (void) interrupt->SetLevel (oldLevel);
+    ASSERT (rwInside == 0);
+    if (which == 0)
+	firstWriterDone = TRUE;
+    else
+	ASSERT (rwReadsDone == 2);	// the readers came before it
+    rwLock->ReleaseWrite ();
+    rwDone->V ();
+}
+
+//----------------------------------------------------------------------
+// RWLockTest
+//      The main thread reads; a writer waits, then two readers, which
+//      must queue behind the writer, then a second writer.  Once the
+//      first writer is done, both readers hold the lock together,
+//      before the second writer.
+//----------------------------------------------------------------------
+
+static void
+WaitArrived (int n)
+{
+    while (rwArrived < n)
+	currentThread->Yield ();
+}
+
+void
+RWLockTest ()
+{
+    rwLock = new RWLock ("test rwlock");
+    rwDone = new Semaphore ("rwlock done", 0);
+
+    rwLock->AcquireRead ();
+    (new Thread ("writer"))->Fork (Writer, 0);
+    WaitArrived (1);
+    (new Thread ("reader"))->Fork (Reader, 0);
+    (new Thread ("reader"))->Fork (Reader, 1);
+    WaitArrived (3);
+    (new Thread ("writer"))->Fork (Writer, 1);
+    WaitArrived (4);
+    ASSERT (rwInside == 0 && !firstWriterDone);
+    rwLock->ReleaseRead ();
+    for (int i = 0; i < 4; i++)
+	rwDone->P ();
+    ASSERT (rwMaxInside == 2);
+    printf ("*** rwlock test: writer preferred, readers woken together\n");
+    rwLock->Print ();
+}
+
+//----------------------------------------------------------------------
+// Owner, Waiter, OtherWaiter, Hog
+//      Threads of InheritTest.  The owner holds the inner lock and
+//      waits for the outer one, held by the main thread, so the waiter
+//      blocked on the inner lock lends its priority along the chain.
+//      The hog has a medium priority: under PRIORITY it must not run
+//      before the waiter got its lock.  As in RWLockTest, a thread is
+//      queued on its lock once it arrived.
+//----------------------------------------------------------------------
+
+static Lock *outerLock, *innerLock, *otherLock;
+static Semaphore *inheritDone;
+static Thread *owner;
+static int arrived;
+static bool waiterDone, hogRan;
+
+static void
+SetOwnPriority (int priority)
+{
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+
+    (void) SetBasePriority (currentThread, priority);
+    (void) interrupt->SetLevel (oldLevel);
+}
+
+static void
+Owner (int dummy)
+{
+    SetOwnPriority (40);
+    innerLock->Acquire ();
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+    arrived++;
+    outerLock->Acquire ();
+    (void) interrupt->SetLevel (oldLevel);
+    outerLock->Release ();
+    innerLock->Release ();
+    ASSERT (currentThread->priority == 40);
+    inheritDone->V ();
+}
+
+static void
+Waiter (int dummy)
+{
+    SetOwnPriority (10);
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+    arrived++;
+    innerLock->Acquire ();
+    (void) interrupt->SetLevel (oldLevel);
+    waiterDone = TRUE;
+    innerLock->Release ();
+    inheritDone->V ();
+}
+
+static void
+OtherWaiter (int dummy)
+{
+    SetOwnPriority (20);
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+    arrived++;
+    otherLock->Acquire ();
+    (void) interrupt->SetLevel (oldLevel);
+    otherLock->Release ();
+    inheritDone->V ();
+}
+
+static void
+Hog (int dummy)
+{
+    ASSERT (scheduler->getPolicy () != POLICY_PRIORITY || waiterDone);
+    hogRan = TRUE;
+    inheritDone->V ();
+}
+
+//----------------------------------------------------------------------
+// InheritTest
+//      Priority inheritance: the main thread, of a low priority, holds
+//      the outer lock and another one.  Its priority follows the most
+//      urgent waiter of the locks it still holds, through the owner of
+//      the inner lock, and comes back to its own once it holds none.
+//----------------------------------------------------------------------
+
+void
+InheritTest ()
+{
+    outerLock = new Lock ("outer lock", TRUE);
+    innerLock = new Lock ("inner lock", TRUE);
+    otherLock = new Lock ("other lock", TRUE);
+    inheritDone = new Semaphore ("inherit done", 0);
+
+    SetOwnPriority (50);
+    outerLock->Acquire ();
+    otherLock->Acquire ();
+    owner = new Thread ("owner");
+    owner->Fork (Owner, 0);
+    (new Thread ("waiter"))->Fork (Waiter, 0);
+    (new Thread ("other waiter"))->Fork (OtherWaiter, 0);
+    while (arrived < 3)
+	currentThread->Yield ();
+    ASSERT (owner->priority == 10 && currentThread->priority == 10);
+
+    Thread *hog = new Thread ("hog");
+    hog->Fork (Hog, 0);
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+    (void) SetBasePriority (hog, 30);
+    (void) interrupt->SetLevel (oldLevel);
+
+    outerLock->Release ();	// the owner now stands for the waiter
+    ASSERT (currentThread->priority == 20);	// the other lock
+    otherLock->Release ();
+    ASSERT (currentThread->priority == 50);
+    for (int i = 0; i < 4; i++)
+	inheritDone->P ();
+    ASSERT (waiterDone && hogRan);
+    printf ("*** inherit test: priority lent through 2 locks\n");
+    SetOwnPriority (DefaultPriority);
+}
+
 //----------------------------------------------------------------------
 // ThreadTest
 //      Set up a ping-pong between two threads, by forking a thread 
 //      to call SimpleThread, and then calling SimpleThread ourselves.
+//      Then check locks and conditions with LockTest, reader-writer
+//      locks with RWLockTest, and priority inheritance with InheritTest.
 //----------------------------------------------------------------------
 
 void
@@ -48,4 +329,7 @@ ThreadTest ()
 
     t->Fork (SimpleThread, 1);
     SimpleThread (0);
+    LockTest ();
+    RWLockTest ();
+    InheritTest ();
 }
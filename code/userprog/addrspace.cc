@@ -19,9 +19,14 @@
 #include "system.h"
 #include "addrspace.h"
 #include "noff.h"
+#include "lzcodec.h"
+#include "userthread.h"
 
 #include <strings.h>		/* for bzero */
 
+static int nextPid = 1;		// ids given to address spaces, never reused
+static int totalResident = 0;	// frames charged to all the spaces
+
 //----------------------------------------------------------------------
 // SwapHeader
 //      Do little endian to big endian conversion on the bytes in the 
@@ -30,7 +35,7 @@
 //----------------------------------------------------------------------
 
 static void
-SwapHeader (NoffHeader * noffH)
+SwapHeader (NoffHeader2 * noffH)
 {
     noffH->noffMagic = WordToHost (noffH->noffMagic);
     noffH->code.size = WordToHost (noffH->code.size);
@@ -43,33 +48,90 @@ SwapHeader (NoffHeader * noffH)
     noffH->uninitData.virtualAddr =
 	WordToHost (noffH->uninitData.virtualAddr);
     noffH->uninitData.inFileAddr = WordToHost (noffH->uninitData.inFileAddr);
+    noffH->entryPoint = WordToHost (noffH->entryPoint);
+    noffH->codeFlags = WordToHost (noffH->codeFlags);
+    noffH->initDataFlags = WordToHost (noffH->initDataFlags);
+    noffH->uninitDataFlags = WordToHost (noffH->uninitDataFlags);
+    noffH->imageFlags = WordToHost (noffH->imageFlags);
+    noffH->pageIndex = WordToHost (noffH->pageIndex);
+    noffH->symbols.size = WordToHost (noffH->symbols.size);
+    noffH->symbols.inFileAddr = WordToHost (noffH->symbols.inFileAddr);
+}
+
+//----------------------------------------------------------------------
+// ReadHeader
+//      Read the header of a NOFF file of either version.  The fields
+//      which only exist in version 2 are given the values matching a
+//      version 1 file: entry point 0, writable code, no compression.
+//
+//      Returns FALSE if the file is not a NOFF file.
+//----------------------------------------------------------------------
+
+static bool
+ReadHeader (OpenFile * executable, NoffHeader2 * noffH)
+{
+    executable->ReadAt ((char *) noffH, sizeof (NoffHeader2), 0);
+    if (noffH->noffMagic != NOFFMAGIC && noffH->noffMagic != NOFFMAGIC2
+	&& (WordToHost (noffH->noffMagic) == NOFFMAGIC
+	    || WordToHost (noffH->noffMagic) == NOFFMAGIC2))
+	SwapHeader (noffH);
+    if (noffH->noffMagic == NOFFMAGIC2)
+	return TRUE;
+    if (noffH->noffMagic != NOFFMAGIC)
+	return FALSE;
+
+    noffH->entryPoint = 0;
+    noffH->codeFlags = NOFF_READ | NOFF_WRITE | NOFF_EXEC;
+    noffH->initDataFlags = NOFF_READ | NOFF_WRITE;
+    noffH->uninitDataFlags = NOFF_READ | NOFF_WRITE;
+    noffH->imageFlags = 0;
+    noffH->pageIndex = 0;
+    noffH->symbols.size = 0;
+    noffH->symbols.inFileAddr = 0;
+    return TRUE;
 }
 
-static void ReadAtVirtual(OpenFile *executable, int virtualaddr, int numBytes, int position, TranslationEntry *pageTable, unsigned numPages) {
+// Copies "numBytes" of the executable, starting at "position", to the
+// virtual address "virtualaddr" of "space".  The bytes are read straight
+// into the frames mapping the destination pages, so the address space
+// does not need to be the one currently installed in the machine.
+static void ReadAtVirtual(OpenFile *executable, int virtualaddr, int numBytes, int position, AddrSpace *space) {
 
-    if ((numBytes <= 0) ||  (virtualaddr < 0) || ((unsigned)virtualaddr > numPages * PageSize)) {
+    if ((numBytes <= 0) ||  (virtualaddr < 0)) {
 		printf("[ERROR] ReadAtVirtual address invalid!\n");
 		return;
 	}
 
-	int numPages_old = machine->pageTableSize;
-	TranslationEntry *page_old = machine->pageTable;
-
-	char *into = new char[numBytes+(numBytes%4)];
-	executable->ReadAt(into,numBytes,position);
-	int i;
-
-	machine->pageTable = pageTable ;
-	machine->pageTableSize = numPages ;
-	
-	for (i=0; i < numBytes; i+=4) {
-		machine->WriteMem((int)(virtualaddr+i), 4, (int)(*(int *)(into+i)));
+	int done = 0;
+	while (done < numBytes) {
+		unsigned vaddr = virtualaddr + done;
+		TranslationEntry *entry = space->GetEntry(vaddr / PageSize);
+		if (entry == NULL || !entry->valid) {
+			printf("[ERROR] ReadAtVirtual address invalid!\n");
+			break;
+		}
+		int offset = vaddr % PageSize;
+		int n = PageSize - offset;
+		if (n > numBytes - done)
+			n = numBytes - done;
+		executable->ReadAt(&machine->mainMemory[entry->physicalPage * PageSize + offset], n, position + done);
+		done += n;
 	}
+}
 
-	machine->pageTable = page_old ;
-	machine->pageTableSize = numPages_old ;
+// Tells whether the code and data of a program are laid out in the file
+// as in memory, from a page aligned position, as coff2noff does now: the
+// pages of the program image can then be read straight from the file
+// when they are first accessed.  Returns the position of address 0.
+static int ImageBase(NoffHeader2 *noffH) {
+	int base = noffH->code.inFileAddr - noffH->code.virtualAddr;
 
-	delete [] into;
+	if (noffH->code.size <= 0 || base <= 0 || base % PageSize != 0)
+		return -1;
+	if (noffH->initData.size > 0
+	    && noffH->initData.inFileAddr - noffH->initData.virtualAddr != base)
+		return -1;
+	return base;
 }
 
 //----------------------------------------------------------------------
@@ -84,21 +146,21 @@ static void ReadAtVirtual(OpenFile *executable, int virtualaddr, int numBytes, i
 //      memory.  For now, this is really simple (1:1), since we are
 //      only uniprogramming, and we have a single unsegmented page table
 //
-//      "executable" is the file containing the object code to load into memory
+//      "executable" is the file containing the object code to load into memory.
+//      The address space keeps it open, to load pages from it on demand,
+//      and deletes it with itself.
+//
+//      Both versions of NOFF are accepted.  With version 2, the text
+//      pages are mapped read-only, and the image may be compressed.
 //----------------------------------------------------------------------
 
 AddrSpace::AddrSpace (OpenFile * executable)
 {
-    NoffHeader noffH;
+    NoffHeader2 noffH;
     unsigned int i, size;
-    int numPagesOld;
-    TranslationEntry *oldPage;
 
-    executable->ReadAt ((char *) &noffH, sizeof (noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) &&
-	(WordToHost (noffH.noffMagic) == NOFFMAGIC))
-	SwapHeader (&noffH);
-    ASSERT (noffH.noffMagic == NOFFMAGIC);
+    bool isNoff = ReadHeader (executable, &noffH);
+    ASSERT (isNoff);
 
 // how big is address space?
     size = noffH.code.size + noffH.initData.size + noffH.uninitData.size + UserStackSize;	// we need to increase the size
@@ -106,59 +168,180 @@ AddrSpace::AddrSpace (OpenFile * executable)
     numPages = divRoundUp (size, PageSize);
     size = numPages * PageSize;
 
-    ASSERT (numPages <= NumPhysPages);	// check we're not trying
-    // to run anything too big --
-    // at least until we have
-    // virtual memory
+    heapFirst = numPages;
+    brk = numPages * PageSize;
+
+    pid = nextPid++;
+    residentPages = 0;
+    peakResidentPages = 0;
+    frameLimit = frameProvider->GetDefaultFrameLimit();
+    telemetry = new VmStats ();
 
-    DEBUG ('a', "Initializing address space, num pages %d, size %d\n",
-	   numPages, size);
+    for (i = 0; i < MaxOpenFiles; i++)
+	openFiles[i] = NULL;
+    regions = NULL;
+    shmMappings = NULL;
+    vmLock = new Semaphore ("VmLock", 1);
+    imageFile = executable;
+    entryPoint = noffH.entryPoint;
 
-    // Check if a new frame can be allocated by the frameprovider
-    isOverflow = (unsigned) frameProvider->NumAvailFrame() < numPages;
-    if (isOverflow) return;
+    workingSet = 0;
+    suspended = FALSE;
+    numSuspendedThreads = 0;
+    resumeSem = new Semaphore ("Resume", 0);
+    loadControl->AddSpace (this);
+    userTicks = systemTicks = waitTicks = 0;
+    share = new ShareGroup (pid);
+    IntStatus oldLevel = interrupt->SetLevel (IntOff);
+    scheduler->AddGroup (share);
+    (void) interrupt->SetLevel (oldLevel);
 
-    pageTable = new TranslationEntry[numPages];
-    for (i = 0; i < numPages; i++)
+    DEBUG ('a', "Initializing address space %d, num pages %d, size %d\n",
+	   pid, numPages, size);
+
+    // With an aligned executable, the code and data pages are mapped from
+    // the file and only loaded when first accessed: frames are reserved
+    // for the rest (bss and stack) only
+    int base = ImageBase (&noffH);
+    unsigned imagePages = 0;
+    int imageSize = 0;
+    if (base > 0)
+      {
+	  imageSize = noffH.code.virtualAddr + noffH.code.size;
+	  if (noffH.initData.size > 0)
+	      imageSize = noffH.initData.virtualAddr + noffH.initData.size;
+	  imagePages = divRoundUp (imageSize, PageSize);
+	  if (imagePages >= numPages)
+	      imagePages = 0;	// sections are not contiguous, load it all
+      }
+    // a compressed image can only be loaded page by page
+    ASSERT (imagePages > 0 || !(noffH.imageFlags & NOFF_COMPRESSED));
+
+    // then the bss, up to the page where it ends, is zero-filled on demand
+    zeroFillFirst = imagePages;
+    zeroFillEnd = imagePages;
+    if (imagePages > 0 && noffH.uninitData.size > 0)
       {
-	  pageTable[i].virtualPage = i;	// for now, virtual page # = phys page #
-	  pageTable[i].physicalPage = frameProvider->GetEmptyFrame();
-	  pageTable[i].valid = TRUE;
-	  pageTable[i].use = FALSE;
-	  pageTable[i].dirty = FALSE;
-	  pageTable[i].readOnly = FALSE;	// if the code segment was entirely on 
-	  // a separate page, we could set its 
-	  // pages to be read-only
+	  unsigned bssEnd = divRoundUp (noffH.uninitData.virtualAddr
+					+ noffH.uninitData.size, PageSize);
+	  if (bssEnd > imagePages && bssEnd < numPages)
+	      zeroFillEnd = bssEnd;
       }
 
-    
-    for (i = 0; i < MAX_USER_THREADS; i++) {
-        this->SemForJoins[i] = new Semaphore("ThreadSemJoin", 1);
+    // The program and its stack must end below the heap and the
+    // mappings, well inside the MaxVirtPages of the address space.  It
+    // may be larger than physical memory with paging
+    tooBig = numPages > HeapEnd / PageSize;
+    if (tooBig) {
+        isOverflow = TRUE;
+        numReserved = numPages;
+        return;
     }
 
-    oldPage = machine->pageTable;
-    numPagesOld = machine->pageTableSize;
+    // Reserve all the frames of the address space in one go, the
+    // frameprovider either gives us all of them or none.  Without
+    // paging, a page of the image or of the bss could not get a frame
+    // on its first access once memory is full: their frames are
+    // reserved too, and the image is read in below
+    unsigned firstReserved = frameProvider->GetPaging () ? zeroFillEnd : 0;
+    numReserved = numPages - firstReserved;
+    int *frames = new int[numPages];
+    isOverflow = !frameProvider->GetEmptyFrames(numReserved, frames, this, firstReserved);
+    if (isOverflow) {
+        delete [] frames;
+        return;
+    }
+
+    // Either a linear page table covering the program, or an empty page
+    // directory whose second-level tables are allocated on demand
+    if (sparsePageTables)
+      {
+	  pageTable = NULL;
+	  pageTableSize = 0;
+	  pageDirectory = new TranslationEntry *[PageDirectorySize];
+	  for (i = 0; i < PageDirectorySize; i++)
+	      pageDirectory[i] = NULL;
+      }
+    else
+      {
+	  pageDirectory = NULL;
+	  pageTable = NewPageTable (0, numPages);
+	  pageTableSize = numPages;
+      }
+
+    for (i = firstReserved; i < numPages; i++)
+      {
+	  TranslationEntry *entry = GetEntry (i, TRUE);
+	  entry->physicalPage = frames[i - firstReserved];
+	  entry->valid = TRUE;
+	  entry->readOnly = FALSE;	// the code segment is mapped with
+	  // the image, it is read-only there
+      }
 
-    machine->pageTable = pageTable;
-    machine->pageTableSize = numPages;
 
     // Zero out the addrspace
-    for (i = 0; i < numPages * PageSize; i += 4) {
-        machine->WriteMem(i, 4, 0);
+    for (i = firstReserved; i < numPages; i++) {
+        bzero(&machine->mainMemory[frames[i - firstReserved] * PageSize], PageSize);
     }
 
-    machine->pageTable = oldPage;
-    machine->pageTableSize = numPagesOld;
+    threads = new UserThreadTable ();
+    stackSlots = NULL;
+    freeStacks = NULL;
+    numFreeStacks = 0;
+    nextStack = 0;
 
-    stack = new BitMap(MAX_USER_THREADS);
-    for (i = 0; i < NumThreadPages; i++) {
-        stack->Mark(i);
-    }
+    if (imagePages > 0)
+      {
+	  DEBUG ('a', "Mapping the program image, %d bytes at %d in the file\n",
+		 imageSize, base);
+	  Region *image = new Region;
+	  image->firstVpn = 0;
+	  image->numPages = imagePages;
+	  image->file = executable;
+	  image->fileId = -1;
+	  image->shared = FALSE;
+	  image->offset = base;
+	  image->length = imageSize;
+	  image->nextVpn = 0;
+	  image->window = 0;
+	  image->prefetched = new BitMap (imagePages);
+	  image->next = regions;
+	  regions = image;
 
-    isEnd = false;
-    blockThread = new Semaphore("BlockMultipleThreads", 0);
-    tsem = new Semaphore("ThreadSemaphore", 1);
-    numThreads = 0;
+	  // The pages holding nothing but code are read-only, unless the
+	  // file says the code is writable
+	  image->readOnlyFirst = 0;
+	  image->readOnlyEnd = 0;
+	  if (!(noffH.codeFlags & NOFF_WRITE))
+	    {
+		image->readOnlyFirst = divRoundUp (noffH.code.virtualAddr, PageSize);
+		image->readOnlyEnd = (noffH.code.virtualAddr + noffH.code.size) / PageSize;
+		if (noffH.initData.size > 0
+		    && (unsigned) noffH.initData.virtualAddr / PageSize < image->readOnlyEnd)
+		    image->readOnlyEnd = noffH.initData.virtualAddr / PageSize;
+	    }
+
+	  image->pageIndex = NULL;
+	  if (noffH.imageFlags & NOFF_COMPRESSED)
+	    {
+		DEBUG ('a', "Image compressed, page index at %d\n",
+		       noffH.pageIndex);
+		image->pageIndex = new int[imagePages + 1];
+		executable->ReadAt ((char *) image->pageIndex,
+				    (imagePages + 1) * sizeof (int),
+				    noffH.pageIndex);
+		for (i = 0; i <= imagePages; i++)
+		    image->pageIndex[i] = WordToHost (image->pageIndex[i]);
+	    }
+
+	  for (i = 0; i < zeroFillEnd; i++)
+	      GetEntry (i, TRUE);
+	  if (firstReserved == 0)
+	      LoadPages (image, 0, imagePages, frames);
+	  delete [] frames;
+	  return;
+      }
+    delete [] frames;
 
 // then, copy in the code and data segments into memory
     if (noffH.code.size > 0)
@@ -167,7 +350,7 @@ AddrSpace::AddrSpace (OpenFile * executable)
 		 noffH.code.virtualAddr, noffH.code.size);
 	//   executable->ReadAt (&(machine->mainMemory[noffH.code.virtualAddr]),
 	// 		      noffH.code.size, noffH.code.inFileAddr);
-        ReadAtVirtual(executable, noffH.code.virtualAddr, noffH.code.size, noffH.code.inFileAddr, pageTable, numPages);
+        ReadAtVirtual(executable, noffH.code.virtualAddr, noffH.code.size, noffH.code.inFileAddr, this);
       }
     if (noffH.initData.size > 0)
       {
@@ -177,14 +360,20 @@ AddrSpace::AddrSpace (OpenFile * executable)
 	// 		      (machine->mainMemory
 	// 		       [noffH.initData.virtualAddr]),
 	// 		      noffH.initData.size, noffH.initData.inFileAddr);
-        ReadAtVirtual(executable, noffH.initData.virtualAddr, noffH.initData.size, noffH.initData.inFileAddr, pageTable, numPages);
+        ReadAtVirtual(executable, noffH.initData.virtualAddr, noffH.initData.size, noffH.initData.inFileAddr, this);
       }
 
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-//      Dealloate an address space.  Nothing for now!
+//      Deallocate an address space, once its last thread exits.  The
+//      mapped files are written back and unmapped, the shared memory
+//      segments detached, and the open files closed.  Then the frames
+//      are given back, the evictions still in progress waited for, and
+//      the pages in the page store forgotten.  The space leaves the
+//      load control and its share group, whose CPU time it reports
+//      with the 'p' debug flag, and the image file is closed.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace ()
@@ -192,16 +381,75 @@ AddrSpace::~AddrSpace ()
   // LB: Missing [] for delete
   // delete pageTable;
   if (!isOverflow) {
-      for (unsigned i = 0; i < MAX_USER_THREADS; i++) {
-          delete this->SemForJoins[i];
+      // Write back the mapped files before their frames are released
+      while (regions != NULL)
+          UnmapRegion(regions);
+      while (shmMappings != NULL)
+          UnmapSegment(shmMappings);
+      for (unsigned i = 0; i < MaxOpenFiles; i++) {
+          if (openFiles[i] != NULL)
+              delete openFiles[i];
+      }
+      if (pageDirectory != NULL) {
+          for (unsigned i = 0; i < PageDirectorySize; i++) {
+              if (pageDirectory[i] != NULL)
+                  ReleaseFrames(pageDirectory[i], PageTableL2Size);
+          }
+      } else {
+          ReleaseFrames(pageTable, pageTableSize);
       }
-      for (unsigned i = 0; i < isOverflow; i++) {
-          frameProvider->ReleaseFrame(pageTable[i].physicalPage);
+      // No page is valid any more, so no new eviction starts, but one in
+      // progress still uses the page table and the page store
+      frameProvider->WaitForEvictions(this);
+      pageStore->Discard(this);
+      if (pageDirectory != NULL) {
+          for (unsigned i = 0; i < PageDirectorySize; i++)
+              delete [] pageDirectory[i];
+          delete [] pageDirectory;
+      } else {
+          delete []pageTable;
       }
-      delete stack;
-      delete []pageTable;
+      delete threads;
+      delete stackSlots;
+      delete [] freeStacks;
   }
+  delete vmLock;
+  delete imageFile;
+  loadControl->RemoveSpace (this);
+  delete resumeSem;
   // End of modification
+
+  DEBUG ('a', "Deleting address space %d, peak resident pages %d\n",
+	 pid, peakResidentPages);
+  if (DebugIsEnabled ('v'))
+    {
+	char name[32];
+	snprintf (name, sizeof (name), "process %d", pid);
+	telemetry->Print (name);
+    }
+  delete telemetry;
+  frameProvider->SpaceDestroyed (this);
+
+  // The exiting thread finishes as a kernel thread, its CPU time is
+  // charged to the process before the group goes
+  IntStatus oldLevel = interrupt->SetLevel (IntOff);
+  scheduler->RemoveGroup (share);
+  if (currentThread->space == this)
+    {
+      scheduler->Account (currentThread);
+      AddCpuTime (currentThread);
+      currentThread->space = NULL;
+    }
+  (void) interrupt->SetLevel (oldLevel);
+  delete share;
+
+  if (DebugIsEnabled ('p'))
+    {
+	if (!isOverflow)
+	    printf ("Process %d: %lld user, %lld system, %lld wait ticks\n",
+		    pid, userTicks, systemTicks, waitTicks);
+	scheduler->PrintThreads ();
+    }
 }
 
 //----------------------------------------------------------------------
@@ -222,12 +470,13 @@ AddrSpace::InitRegisters ()
     for (i = 0; i < NumTotalRegs; i++)
 	machine->WriteRegister (i, 0);
 
-    // Initial program counter -- must be location of "Start"
-    machine->WriteRegister (PCReg, 0);
+    // Initial program counter -- must be location of "Start", which
+    // is 0 unless the executable says otherwise
+    machine->WriteRegister (PCReg, entryPoint);
 
     // Need to also tell MIPS where next instruction is, because
     // of branch delay possibility
-    machine->WriteRegister (NextPCReg, 4);
+    machine->WriteRegister (NextPCReg, entryPoint + 4);
 
     // Set the stack register to the end of the address space, where we
     // allocated the stack; but subtract off a bit, to make sure we don't
@@ -242,15 +491,13 @@ AddrSpace::InitRegisters ()
 //      On a context switch, save any machine state, specific
 //      to this address space, that needs saving.
 //
-//      For now, nothing!
+//      Nothing: the page tables belong to the address space and are
+//      only changed through it, the machine just points to them.
 //----------------------------------------------------------------------
 
 void
 AddrSpace::SaveState ()
 {
-    // SHIVA: Now we have more than 1 execution context (multiple threads) so we are saving the current execution context
-    this->pageTable = machine->pageTable;
-    this->numPages = machine->pageTableSize;
 }
 
 //----------------------------------------------------------------------
@@ -265,72 +512,870 @@ void
 AddrSpace::RestoreState ()
 {
     machine->pageTable = pageTable;
-    machine->pageTableSize = numPages;
+    machine->pageTableSize = pageTableSize;
+    machine->pageDirectory = pageDirectory;
+    machine->pageDirectorySize = pageDirectory != NULL ? PageDirectorySize : 0;
+    machine->FlushTranslationCache ();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::NewPageTable
+//      Allocate "size" page table entries, for the virtual pages
+//      starting at "firstVpn", all of them invalid.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+AddrSpace::NewPageTable (unsigned firstVpn, unsigned size)
+{
+    TranslationEntry *table = new TranslationEntry[size];
+
+    for (unsigned i = 0; i < size; i++)
+      {
+	  table[i].virtualPage = firstVpn + i;
+	  table[i].physicalPage = 0;
+	  table[i].valid = FALSE;
+	  table[i].readOnly = FALSE;
+	  table[i].use = FALSE;
+	  table[i].dirty = FALSE;
+      }
+    return table;
 }
 
-bool AddrSpace::IsStackFree() {
-	return (stack->NumClear()) > 0;
+//----------------------------------------------------------------------
+// AddrSpace::GetEntry
+//      Return the page table entry of virtual page "vpn", or NULL if
+//      the page table does not reach it.
+//
+//      With "allocate", the page table is extended instead: a missing
+//      second-level table is created, or the linear table is grown up
+//      to "vpn".  Growing the linear table costs an entry for every page
+//      of the gap, which is what the two-level table avoids.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+AddrSpace::GetEntry (unsigned vpn, bool allocate)
+{
+    if (vpn >= MaxVirtPages)
+	return NULL;
+
+    if (pageDirectory != NULL)
+      {
+	  TranslationEntry *table = pageDirectory[vpn >> PageTableL2Bits];
+	  if (table == NULL)
+	    {
+		if (!allocate)
+		    return NULL;
+		table = NewPageTable (vpn & ~PageTableL2Mask, PageTableL2Size);
+		pageDirectory[vpn >> PageTableL2Bits] = table;
+	    }
+	  return &table[vpn & PageTableL2Mask];
+      }
+
+    if (vpn >= pageTableSize)
+      {
+	  if (!allocate)
+	      return NULL;
+	  TranslationEntry *table = NewPageTable (0, vpn + 1);
+	  for (unsigned i = 0; i < pageTableSize; i++)
+	      table[i] = pageTable[i];
+	  delete [] pageTable;
+	  pageTable = table;
+	  pageTableSize = vpn + 1;
+
+	  // the machine (and its translation cache) may still point to
+	  // the old table
+	  if (currentThread->space == this)
+	      RestoreState ();
+      }
+    return &pageTable[vpn];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ReleaseFrames
+//      Give back to the frame provider the frames mapped by the "size"
+//      entries of "table".
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ReleaseFrames (TranslationEntry *table, unsigned size)
+{
+    for (unsigned i = 0; i < size; i++)
+      {
+	  if (table[i].valid)
+	    {
+		frameProvider->ReleaseFrame (table[i].physicalPage);
+		table[i].valid = FALSE;
+	    }
+      }
 }
 
 bool AddrSpace::IsStackFull() {
 	return isOverflow;
 }
 
-int AddrSpace::UserStackAllocate() {
-	tsem->P();
-	
-    // By default we allocate 4 pages for each thread
-	if ((stack->NumClear()) <= (NumThreadPages - 1)) {
-		printf("Unable to allocate stack\n");
+bool AddrSpace::IsTooBig() {
+	return tooBig;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AllocateThreadStack
+//      Find a stack for a new user thread in the stack region: one
+//      given back by an exited thread, or the next one never used.
+//      Only the page table entries are made, the pages are zero-filled
+//      on their first access.
+//
+//      Returns the stack slot, or -1 if the region is full.
+//----------------------------------------------------------------------
+
+int AddrSpace::AllocateThreadStack() {
+	vmLock->P();
+	if (stackSlots == NULL) {
+		stackSlots = new BitMap(MaxThreadStacks);
+		freeStacks = new int[MaxThreadStacks];
+	}
+	int slot;
+	if (numFreeStacks > 0) {
+		slot = freeStacks[--numFreeStacks];
+	} else if (nextStack < MaxThreadStacks) {
+		slot = nextStack++;
+	} else {
+		vmLock->V();
+		return -1;
+	}
+	stackSlots->Mark(slot);
+
+	unsigned firstVpn = ThreadStackBase / PageSize + slot * ThreadStackPages;
+	for (unsigned vpn = firstVpn + 1; vpn < firstVpn + ThreadStackPages; vpn++) {
+		GetEntry(vpn, TRUE);
+		// an eviction may have completed after the stack was released
+		pageStore->Discard(this, vpn);
+	}
+	vmLock->V();
+	return slot;
+}
+
+// Gives back the frames of a stack, once its thread exited
+void AddrSpace::ReleaseThreadStack(int slot) {
+	vmLock->P();
+	unsigned firstVpn = ThreadStackBase / PageSize + slot * ThreadStackPages;
+	for (unsigned vpn = firstVpn + 1; vpn < firstVpn + ThreadStackPages; vpn++) {
+		TranslationEntry *entry = GetEntry(vpn);
+		if (entry->valid) {
+			entry->valid = FALSE;
+			frameProvider->ReleaseFrame(entry->physicalPage);
+		}
+		pageStore->Discard(this, vpn);
+	}
+	if (currentThread->space == this)
+		machine->FlushTranslationCache();
+	stackSlots->Clear(slot);
+	freeStacks[numFreeStacks++] = slot;
+	vmLock->V();
+}
+
+int AddrSpace::ThreadStackTop(int slot) {
+	return ThreadStackBase + (slot + 1) * ThreadStackPages * PageSize - 16;
+}
+
+UserThreadTable *AddrSpace::Threads() {
+	return threads;
+}
+
+ShareGroup *AddrSpace::Share() {
+	return share;
+}
+
+// Set the CPU tickets of the process, under the STRIDE and LOTTERY
+// policies its share of the CPU is proportional to them
+int AddrSpace::SetTickets(int tickets) {
+	if (tickets <= 0 || tickets > MaxTickets) {
+		printf("[ERROR] Tickets %d out of range [1, %d]!\n", tickets, MaxTickets);
 		return -1;
 	}
+	IntStatus oldLevel = interrupt->SetLevel(IntOff);
+	int old = scheduler->SetTickets(share, tickets);
+	(void) interrupt->SetLevel(oldLevel);
+	return old;
+}
 
-	int tmp = stack->Find();
-	for(int i=1; i < NumThreadPages; i++) {
-		if(stack->Test(tmp + i)) {
-			printf("Pages block(%d) is not available\n", NumThreadPages);
+// Add the CPU time of "thread" to the totals of the process, and zero
+// its counters so that it is never added twice.  Interrupts are off.
+void AddrSpace::AddCpuTime(Thread *thread) {
+	userTicks += thread->userTicks;
+	systemTicks += thread->systemTicks;
+	waitTicks += thread->waitTicks;
+	thread->userTicks = thread->systemTicks = thread->waitTicks = 0;
+}
+
+// Block Halt() when there are other alive threads
+void AddrSpace::IsLastThread() {
+	threads->WaitAll();
+}
+
+int AddrSpace::GetPid() {
+	return pid;
+}
+
+int AddrSpace::NumResidentPages() {
+	return residentPages;
+}
+
+int AddrSpace::PeakResidentPages() {
+	return peakResidentPages;
+}
+
+int AddrSpace::GetFrameLimit() {
+	return frameLimit;
+}
+
+void AddrSpace::SetFrameLimit(int limit) {
+	frameLimit = limit;
+}
+
+// Keeps the resident set counters up to date, called by the FrameProvider
+// each time it hands a frame to this space or takes one back
+void AddrSpace::ChargeFrames(int n) {
+	residentPages += n;
+	if (residentPages > peakResidentPages)
+		peakResidentPages = residentPages;
+	totalResident += n;
+	telemetry->RecordRss(residentPages);
+	vmStats->RecordRss(totalResident);
+}
+
+int AddrSpace::NumPages() {
+	return numPages;
+}
+
+int AddrSpace::NumReservedPages() {
+	return numReserved;
+}
+
+int AddrSpace::GetWorkingSet() {
+	return workingSet;
+}
+
+void AddrSpace::SetWorkingSet(int n) {
+	workingSet = n;
+}
+
+bool AddrSpace::IsSuspended() {
+	return suspended;
+}
+
+// May be called from an interrupt handler: the threads of the space are
+// only stopped when they next take a page fault, which happens soon
+// enough for a thrashing process
+void AddrSpace::Suspend() {
+	suspended = TRUE;
+}
+
+void AddrSpace::Resume() {
+	suspended = FALSE;
+	while (numSuspendedThreads > 0) {
+		numSuspendedThreads--;
+		resumeSem->V();
+	}
+}
+
+// A thread which stops gives all the frames of the space back, the pages
+// are faulted in again once the space is resumed
+void AddrSpace::WaitWhileSuspended() {
+	if (!suspended)
+		return;
+	frameProvider->EvictSpace(this);
+	if (!suspended)
+		return;
+	numSuspendedThreads++;
+	resumeSem->P();
+}
+
+// Files opened by the program get ids from 2 on, 0 and 1 being the console
+int AddrSpace::AddOpenFile(OpenFile *file) {
+	for (int i = 2; i < MaxOpenFiles; i++) {
+		if (openFiles[i] == NULL) {
+			openFiles[i] = file;
+			return i;
+		}
+	}
+	printf("[ERROR] Too many open files\n");
+	return -1;
+}
+
+OpenFile *AddrSpace::GetOpenFile(int id) {
+	if (id < 2 || id >= MaxOpenFiles)
+		return NULL;
+	return openFiles[id];
+}
+
+// A file can not be closed while it is still mapped
+int AddrSpace::CloseOpenFile(int id) {
+	if (GetOpenFile(id) == NULL)
+		return -1;
+	for (Region *r = regions; r != NULL; r = r->next) {
+		if (r->fileId == id) {
+			printf("[ERROR] Close: file %d is still mapped\n", id);
 			return -1;
 		}
-		stack->Mark(tmp + i);
 	}
-	numThreads++;
-	tsem->V();
-	return tmp;
+	delete openFiles[id];
+	openFiles[id] = NULL;
+	return 0;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Mmap
+//      Map "length" bytes of the open file "fileId", starting at
+//      "offset", into the first free range of pages above MmapBase.
+//      Nothing is read here: the page table entries are left invalid,
+//      and each page is loaded by HandlePageFault on its first access.
+//
+//      Returns the virtual address of the mapping, or -1.
+//----------------------------------------------------------------------
+
+int AddrSpace::Mmap(int fileId, int offset, int length) {
+	OpenFile *file = GetOpenFile(fileId);
+	if (file == NULL || offset < 0 || offset % PageSize != 0 || length <= 0) {
+		printf("[ERROR] Mmap: invalid arguments\n");
+		return -1;
+	}
+
+	unsigned size = divRoundUp(length, PageSize);
+	vmLock->P();
+
+	// First fit between the existing regions
+	unsigned vpn = MmapBase / PageSize;
+	Region **prev = &regions;
+	while (*prev != NULL && (*prev)->firstVpn < vpn + size) {
+		if ((*prev)->firstVpn + (*prev)->numPages > vpn)
+			vpn = (*prev)->firstVpn + (*prev)->numPages;
+		prev = &(*prev)->next;
+	}
+	if (vpn + size > MmapEnd / PageSize) {
+		vmLock->V();
+		printf("[ERROR] Mmap: no room left for %d pages\n", size);
+		return -1;
+	}
+
+	Region *region = new Region;
+	region->firstVpn = vpn;
+	region->numPages = size;
+	region->file = file;
+	region->fileId = fileId;
+	region->shared = TRUE;
+	region->offset = offset;
+	region->length = length;
+	region->nextVpn = vpn;
+	region->window = 0;
+	region->prefetched = new BitMap(size);
+	region->readOnlyFirst = 0;
+	region->readOnlyEnd = 0;
+	region->pageIndex = NULL;
+	region->next = *prev;
+	*prev = region;
+
+	// Make sure the page table reaches the region, so that an access
+	// traps as a page fault and not as an address error
+	for (unsigned i = 0; i < size; i++)
+		GetEntry(vpn + i, TRUE);
+
+	vmLock->V();
+	DEBUG('a', "Mmap file %d, offset %d, %d bytes at 0x%x\n", fileId, offset, length, vpn * PageSize);
+	return vpn * PageSize;
+}
+
+int AddrSpace::Munmap(int addr) {
+	vmLock->P();
+	Region *region = FindRegion(addr / PageSize);
+	if (region == NULL || region->fileId < 0 || (unsigned)addr != region->firstVpn * PageSize) {
+		vmLock->V();
+		printf("[ERROR] Munmap: nothing mapped at 0x%x\n", addr);
+		return -1;
+	}
+	UnmapRegion(region);
+	vmLock->V();
+	return 0;
 }
 
-void AddrSpace::RevokeStack (int numStack) {
-	tsem->P();
+//----------------------------------------------------------------------
+// AddrSpace::Sbrk
+//      Move the end of the heap by "increment" bytes.  Nothing is
+//      allocated here: the new pages are zero-filled by HandlePageFault
+//      on their first access.  The pages given back lose their frame,
+//      and their copy in the page store if they were evicted.
+//
+//      Returns the previous end of the heap, or -1.
+//----------------------------------------------------------------------
+
+int AddrSpace::Sbrk(int increment) {
+	vmLock->P();
+	int old = brk;
+	if (increment < (int) heapFirst * PageSize - old || increment > HeapEnd - old) {
+		vmLock->V();
+		printf("[ERROR] Sbrk: heap out of bounds\n");
+		return -1;
+	}
+	brk += increment;
 
-	for (int i=0; i < NumThreadPages; i++) {
-		if (!stack->Test(numStack + i)) {
-			printf("[ERROR] numStack %d\n", numStack);
-			return;
+	unsigned oldEnd = divRoundUp(old, PageSize);
+	unsigned newEnd = divRoundUp(brk, PageSize);
+	for (unsigned vpn = oldEnd; vpn < newEnd; vpn++) {
+		// so that an access traps as a page fault
+		GetEntry(vpn, TRUE);
+		// an eviction may have completed after the heap shrank
+		pageStore->Discard(this, vpn);
+	}
+	for (unsigned vpn = newEnd; vpn < oldEnd; vpn++) {
+		TranslationEntry *entry = GetEntry(vpn);
+		if (entry->valid) {
+			entry->valid = FALSE;
+			frameProvider->ReleaseFrame(entry->physicalPage);
 		}
-		stack->Clear(numStack + i);
+		pageStore->Discard(this, vpn);
+	}
+	if (newEnd < oldEnd && currentThread->space == this)
+		machine->FlushTranslationCache();
+
+	vmLock->V();
+	DEBUG('a', "Sbrk %d, heap now ends at 0x%x\n", increment, brk);
+	return old;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ShmCreate, AddrSpace::ShmAttach
+//      Create the shared memory segment "key" of "size" bytes, or find
+//      it, and map its frames into the first free range of pages above
+//      ShmBase.  The pages are valid from the start, and stay so: the
+//      frames of a segment are never evicted.
+//
+//      Returns the virtual address of the segment, or -1.
+//----------------------------------------------------------------------
+
+int AddrSpace::ShmCreate(int key, int size) {
+	ShmSegment *segment = shmTable->Create(key, size);
+	if (segment == NULL)
+		return -1;
+	return MapSegment(segment);
+}
+
+int AddrSpace::ShmAttach(int key) {
+	ShmSegment *segment = shmTable->Attach(key);
+	if (segment == NULL) {
+		printf("[ERROR] ShmAttach: no segment with key %d\n", key);
+		return -1;
 	}
+	return MapSegment(segment);
+}
 
-	numThreads--;
-	if(isEnd && numThreads == 0) {
-		blockThread->V();
+int AddrSpace::ShmDetach(int addr) {
+	vmLock->P();
+	ShmMapping *mapping = shmMappings;
+	while (mapping != NULL && mapping->firstVpn * PageSize != (unsigned) addr)
+		mapping = mapping->next;
+	if (mapping == NULL) {
+		vmLock->V();
+		printf("[ERROR] ShmDetach: no segment attached at 0x%x\n", addr);
+		return -1;
 	}
+	UnmapSegment(mapping);
+	vmLock->V();
+	return 0;
+}
 
-	tsem->V();
+bool AddrSpace::InSharedMemory(unsigned vpn) {
+	for (ShmMapping *m = shmMappings; m != NULL && m->firstVpn <= vpn; m = m->next) {
+		if (vpn < m->firstVpn + m->segment->numPages)
+			return TRUE;
+	}
+	return FALSE;
 }
 
+// Maps the frames of "segment", on which we already hold a reference
+int AddrSpace::MapSegment(ShmSegment *segment) {
+	unsigned size = segment->numPages;
+	vmLock->P();
+
+	// First fit, as for Mmap
+	unsigned vpn = ShmBase / PageSize;
+	ShmMapping **prev = &shmMappings;
+	while (*prev != NULL && (*prev)->firstVpn < vpn + size) {
+		if ((*prev)->firstVpn + (*prev)->segment->numPages > vpn)
+			vpn = (*prev)->firstVpn + (*prev)->segment->numPages;
+		prev = &(*prev)->next;
+	}
+	if (vpn + size > ShmEnd / PageSize) {
+		vmLock->V();
+		printf("[ERROR] Shm: no room left for %d pages\n", size);
+		shmTable->Detach(segment);
+		return -1;
+	}
+
+	ShmMapping *mapping = new ShmMapping;
+	mapping->firstVpn = vpn;
+	mapping->segment = segment;
+	mapping->next = *prev;
+	*prev = mapping;
+	for (unsigned i = 0; i < size; i++) {
+		TranslationEntry *entry = GetEntry(vpn + i, TRUE);
+		entry->physicalPage = segment->frames[i];
+		entry->readOnly = FALSE;
+		entry->use = FALSE;
+		entry->dirty = FALSE;
+		entry->valid = TRUE;
+	}
 
-int AddrSpace::GetStack(int BitmapValue) {
-	return PageSize * numPages - BitmapValue * PageSize;
+	vmLock->V();
+	DEBUG('a', "Shared segment %d attached at 0x%x\n", segment->key, vpn * PageSize);
+	return vpn * PageSize;
 }
 
-// Block Halt() when there are other alive threads
-void AddrSpace::IsLastThread() {
-	if(numThreads != 0) {
-		isEnd = true;
-		blockThread->P();
-		isEnd = false;
+// Unmaps a segment, and drops our reference on its frames
+void AddrSpace::UnmapSegment(ShmMapping *mapping) {
+	for (int i = 0; i < mapping->segment->numPages; i++)
+		GetEntry(mapping->firstVpn + i)->valid = FALSE;
+	if (currentThread->space == this)
+		machine->FlushTranslationCache();
+
+	ShmMapping **prev = &shmMappings;
+	while (*prev != mapping)
+		prev = &(*prev)->next;
+	*prev = mapping->next;
+	shmTable->Detach(mapping->segment);
+	delete mapping;
+}
+
+Region *AddrSpace::FindRegion(unsigned vpn) {
+	for (Region *r = regions; r != NULL && r->firstVpn <= vpn; r = r->next) {
+		if (vpn < r->firstVpn + r->numPages)
+			return r;
+	}
+	return NULL;
+}
+
+// Writes back the dirty pages of "region" if it is shared, gives back
+// its frames and forgets it
+void AddrSpace::UnmapRegion(Region *region) {
+	for (unsigned i = 0; i < region->numPages; i++) {
+		TranslationEntry *entry = GetEntry(region->firstVpn + i);
+		if (entry == NULL || !entry->valid)
+			continue;
+		if (region->prefetched->Test(i)) {
+			if (entry->use)
+				stats->numPrefetchHits++;
+			else
+				stats->numPrefetchWaste++;
+			region->prefetched->Clear(i);
+		}
+		if (region->shared && entry->dirty) {
+			int bytes = region->length - i * PageSize;
+			if (bytes > PageSize)
+				bytes = PageSize;
+			region->file->WriteAt(&machine->mainMemory[entry->physicalPage * PageSize],
+				bytes, region->offset + i * PageSize);
+			// it may have been evicted while we were writing it
+			if (!entry->valid)
+				continue;
+		}
+		frameProvider->ReleaseFrame(entry->physicalPage);
+		entry->valid = FALSE;
+	}
+	// an eviction may still be writing one of its pages
+	frameProvider->WaitForEvictions(this, region->firstVpn, region->numPages);
+
+	Region **prev = &regions;
+	while (*prev != region)
+		prev = &(*prev)->next;
+	*prev = region->next;
+	delete region->prefetched;
+	delete [] region->pageIndex;
+	delete region;
+
+	if (currentThread->space == this)
+		machine->FlushTranslationCache();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::HandlePageFault
+//      Load the page containing "badVAddr" from the file mapped there.
+//
+//      Since a page is a single sector, faulting on each page would cost
+//      a fault per 128 bytes, so neighbouring pages are loaded with it:
+//      the aligned block of "faultAroundPages" pages around it, and a
+//      read-ahead window which doubles, up to "prefetchWindow" pages,
+//      while the faults follow each other sequentially.  Only the
+//      faulting page is required, the others are skipped if they are
+//      already loaded or if there is no free frame left for them.
+//
+//      Pages which are not part of a file mapping can only fault after
+//      being evicted, and are taken back from the page store, or on
+//      their first access for those of the bss, of the heap and of the
+//      thread stacks, which are then zeroed.
+//
+//      Returns FALSE if nothing is mapped at "badVAddr", or if there is
+//      no frame left for the page.
+//----------------------------------------------------------------------
+
+bool AddrSpace::HandlePageFault(int badVAddr) {
+	unsigned vpn = (unsigned) badVAddr / PageSize;
+
+	WaitWhileSuspended();
+	long long faultTicks = stats->totalTicks;
+	vmLock->P();
+	TranslationEntry *entry = GetEntry(vpn);
+	if (entry == NULL) {
+		vmLock->V();
+		return FALSE;
+	}
+	// Another thread of this space may have loaded it while we waited
+	if (entry->valid) {
+		vmLock->V();
+		return TRUE;
+	}
+	// The heap may have shrunk below the page since its entry was made
+	bool inHeap = vpn >= heapFirst && vpn < (unsigned) divRoundUp(brk, PageSize);
+	if (!inHeap && vpn >= heapFirst && vpn < HeapEnd / PageSize) {
+		vmLock->V();
+		return FALSE;
+	}
+	// Same for a thread stack, whose guard page is never mapped
+	bool inStack = FALSE;
+	if (vpn >= ThreadStackBase / PageSize) {
+		unsigned page = vpn - ThreadStackBase / PageSize;
+		if (page % ThreadStackPages == 0) {
+			vmLock->V();
+			printf("[ERROR] Thread stack overflow at 0x%x\n", badVAddr);
+			return FALSE;
+		}
+		if (stackSlots == NULL || !stackSlots->Test(page / ThreadStackPages)) {
+			vmLock->V();
+			return FALSE;
+		}
+		inStack = TRUE;
+	}
+
+	// If the page is being evicted, this waits for it to be saved
+	int frame = frameProvider->GetEmptyFrame(this, vpn);
+	if (frame < 0) {
+		vmLock->V();
+		printf("[ERROR] No frame left to load page %d\n", vpn);
+		return FALSE;
+	}
+
+	StoredPageKind kind;
+	if (pageStore->Load(this, vpn, &machine->mainMemory[frame * PageSize], &kind)) {
+		entry->physicalPage = frame;
+		entry->use = TRUE;
+		// a page of a private mapping is only stored once modified, it
+		// must not be dropped on its next eviction
+		entry->dirty = FindRegion(vpn) != NULL;
+		entry->valid = TRUE;
+		vmLock->V();
+		FaultDone(badVAddr, kind == ZERO_PAGE ? FAULT_ZERO
+			  : kind == COMPRESSED_PAGE ? FAULT_POOL : FAULT_SWAP, faultTicks);
+		return TRUE;
+	}
+
+	Region *region = FindRegion(vpn);
+	if (region == NULL && (inHeap || inStack
+			       || (vpn >= zeroFillFirst && vpn < zeroFillEnd))) {
+		bzero(&machine->mainMemory[frame * PageSize], PageSize);
+		entry->physicalPage = frame;
+		entry->readOnly = FALSE;
+		entry->use = TRUE;
+		entry->dirty = FALSE;
+		entry->valid = TRUE;
+		vmLock->V();
+		FaultDone(badVAddr, FAULT_ZERO, faultTicks);
+		return TRUE;
+	}
+	if (region == NULL) {
+		frameProvider->ReleaseFrame(frame);
+		vmLock->V();
+		return FALSE;
+	}
+	// Pages [first, last) are loaded
+	unsigned first = vpn;
+	unsigned last = vpn + 1;
+	if (faultAroundPages > 1) {
+		first = vpn - vpn % faultAroundPages;
+		last = first + faultAroundPages;
+	}
+	if (prefetchWindow > 0 && vpn == region->nextVpn) {
+		region->window = region->window == 0 ? 1 : 2 * region->window;
+		if (region->window > prefetchWindow)
+			region->window = prefetchWindow;
+	} else {
+		region->window = 0;
+	}
+	if (vpn + 1 + region->window > last)
+		last = vpn + 1 + region->window;
+	if (first < region->firstVpn)
+		first = region->firstVpn;
+	if (last > region->firstVpn + region->numPages)
+		last = region->firstVpn + region->numPages;
+
+	// Load each run of missing pages
+	int *frames = new int[last - first];
+	unsigned start = first;
+	while (start < last) {
+		if (GetEntry(start, TRUE)->valid) {
+			start++;
+			continue;
+		}
+		unsigned n = 0;
+		bool full = FALSE;
+		while (start + n < last && !GetEntry(start + n, TRUE)->valid) {
+			if (start + n == vpn) {
+				frames[n++] = frame;
+				continue;
+			}
+			int f = frameProvider->GetEmptyFrame(this, start + n, FALSE);
+			if (f < 0) {
+				full = TRUE;
+				break;
+			}
+			region->prefetched->Mark(start + n - region->firstVpn);
+			stats->numPrefetched++;
+			frames[n++] = f;
+		}
+		LoadPages(region, start, n, frames);
+		region->nextVpn = start + n;
+		if (full) {
+			// out of frames: only the faulting page is still needed
+			if (vpn < start + n)
+				break;
+			start = vpn;
+			last = vpn + 1;
+		} else {
+			start += n;
+		}
+	}
+	delete [] frames;
+
+	vmLock->V();
+	DEBUG('a', "Page fault at 0x%x, loaded pages %d to %d\n", badVAddr, first, last - 1);
+	FaultDone(badVAddr, FAULT_FILE, faultTicks);
+	return TRUE;
+}
+
+// Accounts for a page fault which started at tick "start"
+void AddrSpace::FaultDone(int badVAddr, FaultCause cause, long long start) {
+	long long latency = stats->totalTicks - start;
+
+	stats->numPageFaults++;
+	telemetry->RecordFault(cause, latency);
+	vmStats->RecordFault(cause, latency);
+	DEBUG('v', "Process %d: page fault at 0x%x, cause %d, %lld ticks\n",
+	      pid, badVAddr, cause, latency);
+}
+
+// Reads the "n" pages of "region" starting at "firstVpn" into "frames".
+// Each page is a single sector of the file, read straight into its
+// frame, or a compressed page to decode.  The bytes past the end of the
+// mapping are zeroed.
+void AddrSpace::LoadPages(Region *region, unsigned firstVpn, unsigned n, int *frames) {
+	for (unsigned i = 0; i < n; i++) {
+		unsigned vpn = firstVpn + i;
+		TranslationEntry *entry = GetEntry(vpn, TRUE);
+		char *page = &machine->mainMemory[frames[i] * PageSize];
+		int pageOffset = (vpn - region->firstVpn) * PageSize;
+		int bytes = region->length - pageOffset;
+		if (bytes > PageSize)
+			bytes = PageSize;
+
+		int read;
+		int *index = region->pageIndex;
+		if (index != NULL && index[vpn - region->firstVpn + 1]
+		    - index[vpn - region->firstVpn] < PageSize) {
+			char packed[PageSize];
+			int stored = index[vpn - region->firstVpn + 1] - index[vpn - region->firstVpn];
+			read = region->file->ReadAt(packed, stored, index[vpn - region->firstVpn]);
+			read = read == stored ? LzDecompress(packed, stored, page, PageSize) : -1;
+			if (read < 0)
+				printf("[ERROR] Corrupted page %d in the program image\n", vpn);
+		} else if (index != NULL) {
+			read = region->file->ReadAt(page, PageSize, index[vpn - region->firstVpn]);
+		} else {
+			read = region->file->ReadAt(page, bytes, region->offset + pageOffset);
+		}
+		if (read < 0)
+			read = 0;
+		bzero(page + read, PageSize - read);
+
+		entry->physicalPage = frames[i];
+		entry->readOnly = vpn >= region->readOnlyFirst && vpn < region->readOnlyEnd;
+		// the faulting page is about to be used, it must not look like
+		// a good victim to the clock meanwhile
+		entry->use = !region->prefetched->Test(firstVpn + i - region->firstVpn);
+		entry->dirty = FALSE;
+		entry->valid = TRUE;
 	}
 }
 
-bool AddrSpace::Test(int BitmapValue) {
-	return this->stack->Test(BitmapValue);
-}
\ No newline at end of file
+// Called by the clock of the FrameProvider: tells whether page "vpn" was
+// used since the last call, and clears its use bit
+bool AddrSpace::TestAndClearUse(unsigned vpn) {
+	TranslationEntry *entry = GetEntry(vpn);
+	if (!entry->use)
+		return FALSE;
+	entry->use = FALSE;
+
+	Region *region = FindRegion(vpn);
+	if (region != NULL && region->prefetched->Test(vpn - region->firstVpn)) {
+		stats->numPrefetchHits++;
+		region->prefetched->Clear(vpn - region->firstVpn);
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::EvictPage
+//      Save page "vpn" so that its frame can be taken away.  A modified
+//      page of a mapped file goes back to the file, a modified page of
+//      the program image, like any other page, goes to the page store.
+//      The page is invalidated first, so that an access while it is
+//      saved faults, and waits in the frame provider for the eviction
+//      to complete.
+//
+//      Called by the FrameProvider only.  Returns FALSE if the page
+//      could not be saved, and is left in place.
+//----------------------------------------------------------------------
+
+bool AddrSpace::EvictPage(unsigned vpn) {
+	TranslationEntry *entry = GetEntry(vpn);
+	char *page = &machine->mainMemory[entry->physicalPage * PageSize];
+
+	entry->valid = FALSE;
+	if (currentThread->space == this)
+		machine->FlushTranslationCache();
+
+	// Modified pages of private mappings (the program image) are kept
+	// like anonymous pages, the clean ones can be read again
+	Region *region = FindRegion(vpn);
+	if (region == NULL || (!region->shared && entry->dirty)) {
+		if (!pageStore->Store(this, vpn, page)) {
+			// a linear page table may have been reallocated by a
+			// thread of this space during the I/O
+			GetEntry(vpn)->valid = TRUE;
+			return FALSE;
+		}
+		telemetry->RecordEviction();
+		vmStats->RecordEviction();
+		return TRUE;
+	}
+
+	unsigned i = vpn - region->firstVpn;
+	if (region->prefetched->Test(i)) {
+		stats->numPrefetchWaste++;
+		region->prefetched->Clear(i);
+	}
+	if (region->shared && entry->dirty) {
+		int bytes = region->length - i * PageSize;
+		if (bytes > PageSize)
+			bytes = PageSize;
+		region->file->WriteAt(page, bytes, region->offset + i * PageSize);
+	}
+	telemetry->RecordEviction();
+	vmStats->RecordEviction();
+	return TRUE;
+}
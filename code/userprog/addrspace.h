@@ -17,12 +17,74 @@
 #include "filesys.h"
 #include "bitmap.h"
 #include "synch.h"
+#include "vmstats.h"
+#include "shm.h"
+
+class UserThreadTable;
+class ShareGroup;
+class Thread;
 
 #define UserStackSize	 8192	// increase this as necessary! (dependent on the PageSize! Need to think about increasing it more than the PageSize)
-#define NumThreadPages 4
-// This gives the number of thread stacks that can be allocated for a given page size
-// Doing this to avoid putting a const hard limit on num of threads created by a userprog
-#define MAX_USER_THREADS divRoundUp(UserStackSize, PageSize)
+#define NumThreadPages 4	// stack of each user thread
+
+// Size of the user virtual address space, in pages (4MB).  With two-level
+// page tables, only the parts of it actually used cost page table entries.
+#define MaxVirtPages		(1 << 15)
+#define PageDirectorySize	divRoundUp(MaxVirtPages, PageTableL2Size)
+
+// Virtual addresses handed out by Mmap, well above the program image
+#define MmapBase		0x100000
+#define MmapEnd			0x200000
+
+// The heap lies between the stack of the main thread and the mappings
+#define HeapEnd			MmapBase
+
+// Virtual addresses where shared memory segments are attached
+#define ShmBase			0x200000
+#define ShmEnd			0x280000
+
+// The stacks of the user threads, each one above an unmapped guard page,
+// up to the end of the address space.  Their pages are zero-filled on
+// their first access.
+#define ThreadStackBase		0x280000
+#define ThreadStackEnd		(MaxVirtPages * PageSize)
+#define ThreadStackPages	(NumThreadPages + 1)
+#define MaxThreadStacks		((ThreadStackEnd - ThreadStackBase) \
+				 / (ThreadStackPages * PageSize))
+
+#define MaxOpenFiles		16	// per address space, ids 0 and 1 are
+					// the console
+
+// A shared memory segment attached at "firstVpn"
+typedef struct shmMapping_t {
+    unsigned firstVpn;
+    ShmSegment *segment;
+    struct shmMapping_t *next;	// sorted by address
+} ShmMapping;
+
+// A range of virtual pages backed by a file.  Each page is read from
+// the file on its first access.  The modified pages of a shared region
+// are written back when it is unmapped, those of a private region (the
+// program image) never go back to the file.  The pages of a compressed
+// image are decompressed as they are read.
+typedef struct region_t {
+    unsigned firstVpn;
+    unsigned numPages;
+    OpenFile *file;
+    int fileId;			// id of "file" in the open file table,
+    				// -1 for the program image
+    bool shared;		// modifications go to the file
+    int offset;			// position in the file of the first page
+    int length;			// number of bytes of the file mapped
+    unsigned nextVpn;		// page following the last pages loaded
+    int window;			// current read-ahead, in pages
+    BitMap *prefetched;		// pages loaded before being accessed
+    unsigned readOnlyFirst;	// pages [readOnlyFirst, readOnlyEnd) are
+    unsigned readOnlyEnd;	// mapped read-only (the program text)
+    int *pageIndex;		// for a compressed image, position in the
+    				// file of each page, NULL otherwise
+    struct region_t *next;	// regions are sorted by address
+} Region;
 
 class AddrSpace
 {
@@ -35,29 +97,111 @@ class AddrSpace
     void InitRegisters ();	// Initialize user-level CPU registers,
     // before jumping to user code
 
-    Semaphore *SemForJoins[MAX_USER_THREADS];
-    bool IsStackFree();
     bool IsStackFull();
-    int UserStackAllocate();
-    void RevokeStack(int num);
-    int GetStack(int val);
-    void IsLastThread();
-    bool Test(int bitVal);
+    bool IsTooBig ();		// Larger than the address space allows
+    int AllocateThreadStack ();	// Returns a stack slot, or -1
+    void ReleaseThreadStack (int slot);
+    int ThreadStackTop (int slot);	// Initial stack pointer
+    UserThreadTable *Threads ();	// The user threads of the process
+    void IsLastThread();	// Wait for the other threads to exit
+    ShareGroup *Share ();	// CPU tickets of the process
+    int SetTickets (int tickets);	// Returns the previous number, or -1
+    void AddCpuTime (Thread *thread);	// Called when one of its threads
+    				// finishes
 
     void SaveState ();		// Save/restore address space-specific
     void RestoreState ();	// info on a context switch 
 
+    TranslationEntry *GetEntry (unsigned vpn, bool allocate = FALSE);
+    				// Page table entry of a virtual page
+
+    int GetPid ();		// Unique id of this address space
+    int NumResidentPages ();	// Frames currently charged to this space
+    int PeakResidentPages ();	// Highest value reached by the above
+    int GetFrameLimit ();	// Max frames this space may own, 0 = no limit
+    void SetFrameLimit (int limit);
+    void ChargeFrames (int n);	// Called by the FrameProvider only
+    int NumPages ();		// Pages of the program and its stack
+    int NumReservedPages ();	// Frames reserved when it was built
+
+    int GetWorkingSet ();	// Estimated by the LoadControl
+    void SetWorkingSet (int n);
+    bool IsSuspended ();
+    void Suspend ();		// Its threads stop at their next page fault
+    void Resume ();
+    void WaitWhileSuspended ();	// Swap out and wait to be resumed
+
+    int AddOpenFile (OpenFile *file);	// Returns the file id, or -1
+    OpenFile *GetOpenFile (int id);	// NULL if "id" is not open
+    int CloseOpenFile (int id);
+
+    int Mmap (int fileId, int offset, int length);
+    				// Map a file, returns the address or -1
+    int Munmap (int addr);	// Unmap the region mapped at "addr"
+    int Sbrk (int increment);	// Move the end of the heap, returns the
+    				// previous one or -1
+    int ShmCreate (int key, int size);	// Create a shared memory segment
+    int ShmAttach (int key);	// and attach it, return its address or -1
+    int ShmDetach (int addr);	// Detach the segment attached at "addr"
+    bool InSharedMemory (unsigned vpn);	// Is "vpn" in an attached segment
+    bool HandlePageFault (int badVAddr);
+    				// Load a missing page, FALSE if the
+    				// address is not mapped
+    bool TestAndClearUse (unsigned vpn);
+    bool EvictPage (unsigned vpn);	// Save a page before its frame is
+    					// taken, FALSE if it can't be
+
   private:
-      TranslationEntry * pageTable;	// Assume linear page table translation
-    // for now!
-      unsigned int numPages;	// Number of pages in the virtual 
-    // address space
-      BitMap *stack;
-      bool isEnd;
-      bool isOverflow;
-      Semaphore *blockThread;
-      Semaphore *tsem;
-      int numThreads;
+      TranslationEntry * pageTable;	// Linear page table, or NULL
+      unsigned int pageTableSize;	// Number of entries in pageTable
+      TranslationEntry **pageDirectory;	// Two-level page table, or NULL
+      unsigned int numPages;	// Number of pages of the program
+    // and its stack
+      unsigned int numReserved;	// Frames the constructor asked for
+
+      TranslationEntry *NewPageTable (unsigned firstVpn, unsigned size);
+      void ReleaseFrames (TranslationEntry *table, unsigned size);
+      Region *FindRegion (unsigned vpn);
+      void UnmapRegion (Region *region);
+      void LoadPages (Region *region, unsigned firstVpn, unsigned n,
+		      int *frames);
+      void FaultDone (int badVAddr, FaultCause cause, long long start);
+      bool isOverflow;		// no frames, or tooBig: nothing was built
+      bool tooBig;		// would not fit in the address space
+      UserThreadTable *threads;
+      ShareGroup *share;
+      long long userTicks;	// CPU time of its finished threads
+      long long systemTicks;
+      long long waitTicks;
+      BitMap *stackSlots;	// Stacks in use, allocated with the first
+      int *freeStacks;		// thread, and the ones free below
+      int numFreeStacks;	// nextStack
+      int nextStack;
+
+      int pid;
+      int residentPages;
+      int peakResidentPages;
+      int frameLimit;
+      VmStats *telemetry;	// Page faults and evictions of this space
+
+      OpenFile *openFiles[MaxOpenFiles];
+      OpenFile *imageFile;	// Program image, mapped by a region
+      int entryPoint;		// Initial pc
+      unsigned zeroFillFirst;	// Pages [zeroFillFirst, zeroFillEnd), the
+      unsigned zeroFillEnd;	// bss, are zeroed on their first access
+      unsigned heapFirst;	// First page of the heap, which ends at
+      int brk;			// the address "brk", zero-filled as well
+      Region *regions;		// Mapped files, sorted by address
+      ShmMapping *shmMappings;	// Attached shared memory segments
+      int MapSegment (ShmSegment *segment);
+      void UnmapSegment (ShmMapping *mapping);
+      Semaphore *vmLock;	// Protects the regions and their pages,
+      				// since loading a page may block on disk
+
+      int workingSet;
+      bool suspended;
+      int numSuspendedThreads;	// Threads waiting on resumeSem
+      Semaphore *resumeSem;
 };
 
 #endif // ADDRSPACE_H
@@ -22,8 +22,10 @@ BitMap::BitMap (int nitems)
     numBits = nitems;
     numWords = divRoundUp (numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++)
-	Clear (i);
+    // Clear whole words, so that the padding bits past numBits are
+    // zero too and the word scans below can ignore them safely
+    for (int i = 0; i < numWords; i++)
+	map[i] = 0;
 }
 
 //----------------------------------------------------------------------
@@ -92,17 +94,24 @@ BitMap::Test (int which)
 //      (In other words, find and allocate a bit.)
 //
 //      If no bits are clear, return -1.
+//
+//      Full words are skipped at once, and the first clear bit of a
+//      word is located with a count-trailing-zeros instruction.
 //----------------------------------------------------------------------
 
 int
 BitMap::Find ()
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test (i))
-	  {
-	      Mark (i);
-	      return i;
-	  }
+    for (int w = 0; w < numWords; w++)
+      {
+	  if (map[w] == ~0U)
+	      continue;
+	  int i = w * BitsInWord + __builtin_ctz (~map[w]);
+	  if (i >= numBits)
+	      break;
+	  Mark (i);
+	  return i;
+      }
     return -1;
 }
 
@@ -110,17 +119,25 @@ BitMap::Find ()
 // BitMap::NumClear
 //      Return the number of clear bits in the bitmap.
 //      (In other words, how many bits are unallocated?)
+//
+//      Counts the set bits a word at a time with popcount; the padding
+//      bits of the last word are masked out.
 //----------------------------------------------------------------------
 
 int
 BitMap::NumClear ()
 {
-    int count = 0;
-
-    for (int i = 0; i < numBits; i++)
-	if (!Test (i))
-	    count++;
-    return count;
+    int set = 0;
+    int tailBits = numBits % BitsInWord;
+
+    for (int w = 0; w < numWords; w++)
+      {
+	  unsigned int word = map[w];
+	  if (w == numWords - 1 && tailBits != 0)
+	      word &= (1U << tailBits) - 1;
+	  set += __builtin_popcount (word);
+      }
+    return numBits - set;
 }
 
 //----------------------------------------------------------------------
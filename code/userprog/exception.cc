@@ -43,11 +43,53 @@ UpdatePC ()
     machine->WriteRegister (NextPCReg, pc);
 }
 
+// The kernel may touch a page of a mapped file which is not loaded yet:
+// ReadMem/WriteMem then raise the page fault themselves, which loads
+// the page, so the access only has to be tried again
+static bool ReadUserMem(int addr, int size, int *value) {
+	return machine->ReadMem(addr, size, value) || machine->ReadMem(addr, size, value);
+}
+
+static bool WriteUserMem(int addr, int size, int value) {
+	return machine->WriteMem(addr, size, value) || machine->WriteMem(addr, size, value);
+}
+
+// Ends the calling process, once its other threads are done: the exit
+// path of SC_Exit, also taken by a main thread which faulted
+static void ExitProcess() {
+	currentThread->space->IsLastThread();
+	MajNbProc(-1);
+	delete currentThread->space;
+	if (GetNbProc() >= 0) {
+		currentThread->Finish();
+	} else {
+		interrupt->Halt();
+	}
+}
+
+// Called on a fault which can not be recovered: the faulting instruction
+// must not be skipped, so the thread ends there -- the whole process if
+// it is the main thread.  Never returns, also when the fault happened
+// in a kernel copy from or to user memory during a syscall
+static void KillFaultingThread() {
+	if (currentThread->tid == 0) {
+		printf("[ERROR] Process %d killed\n", currentThread->space->GetPid());
+		ExitProcess();
+	} else {
+		printf("[ERROR] Thread %d of process %d killed\n",
+		       currentThread->tid, currentThread->space->GetPid());
+		do_UserThreadExit();
+	}
+	ASSERT(FALSE);		// not reached
+}
+
 // From MIPS machine to Linux mode
 void copyStringFromMachine(int from, char *to, int size) {
 	int i;
 	for (i = 0; i < size; i++) {
-		machine->ReadMem(from+i, 1, (int*)(to+i));
+		int c;
+		ReadUserMem(from+i, 1, &c);
+		to[i] = (char)c;
 
 		if (*(to+i) == '\0') return; // if str end is reached then return
 	}
@@ -58,7 +100,7 @@ void copyStringFromMachine(int from, char *to, int size) {
 void copyStringToMachine(char *from, int to, int size) {
 	int i;
 	for (i = 0; i < size; i++) {
-		machine->WriteMem(to+i, 1, (int)from[i]);
+		WriteUserMem(to+i, 1, (int)from[i]);
 	}
 }
 
@@ -92,14 +134,7 @@ void ExceptionHandler (ExceptionType which) {
 		switch(type) {
 			case SC_Exit:
 			{
-				currentThread->space->IsLastThread();
-				MajNbProc(-1);
-				delete currentThread->space;
-				if (GetNbProc() >= 0) {
-					currentThread->Finish();
-				} else {
-					interrupt->Halt();
-				}
+				ExitProcess();
 			}
 			break;
 			case SC_Halt:
@@ -162,7 +197,77 @@ void ExceptionHandler (ExceptionType which) {
 				int arg = machine->ReadRegister(5);
 
 				// Create, schedule and return thread id of the new thread
-				do_UserThreadCreate(f, arg);
+				machine->WriteRegister(2, do_UserThreadCreate(f, arg));
+			}
+			break;
+			case SC_UserThreadCreateN:
+			{
+				DEBUG('a', "UserThreadCreateN called by user program\n");
+				int f = machine->ReadRegister(4);
+				int from = machine->ReadRegister(5);
+				int n = machine->ReadRegister(6);
+				if (n <= 0 || n > (int) MaxThreadStacks) {
+					printf("[ERROR] UserThreadCreateN: invalid number of threads\n");
+					machine->WriteRegister(2, -1);
+					break;
+				}
+				int *args = new int[n];
+				for (int i = 0; i < n; i++)
+					ReadUserMem(from + 4 * i, 4, &args[i]);
+				machine->WriteRegister(2, do_UserThreadCreateN(f, args, n));
+				delete [] args;
+			}
+			break;
+			case SC_FutexWait:
+			{
+				DEBUG('a', "FutexWait called by user program\n");
+				int addr = machine->ReadRegister(4);
+				int expected = machine->ReadRegister(5);
+				machine->WriteRegister(2, futexTable->Wait(addr, expected));
+			}
+			break;
+			case SC_FutexWake:
+			{
+				DEBUG('a', "FutexWake called by user program\n");
+				int addr = machine->ReadRegister(4);
+				int n = machine->ReadRegister(5);
+				machine->WriteRegister(2, futexTable->Wake(addr, n));
+			}
+			break;
+			case SC_SetPriority:
+			{
+				DEBUG('a', "SetPriority called by user program\n");
+				int tid = machine->ReadRegister(4);
+				int priority = machine->ReadRegister(5);
+				machine->WriteRegister(2, do_SetPriority(tid, priority));
+			}
+			break;
+			case SC_SetTickets:
+			{
+				DEBUG('a', "SetTickets called by user program\n");
+				int tickets = machine->ReadRegister(4);
+				machine->WriteRegister(2, currentThread->space->SetTickets(tickets));
+			}
+			break;
+			case SC_SetRealTime:
+			{
+				DEBUG('a', "SetRealTime called by user program\n");
+				int budget = machine->ReadRegister(4);
+				int period = machine->ReadRegister(5);
+				machine->WriteRegister(2, do_SetRealTime(budget, period));
+			}
+			break;
+			case SC_SetQuantum:
+			{
+				DEBUG('a', "SetQuantum called by user program\n");
+				int ticks = machine->ReadRegister(4);
+				machine->WriteRegister(2, do_SetQuantum(ticks));
+			}
+			break;
+			case SC_Yield:
+			{
+				DEBUG('a', "Yield called by user program\n");
+				currentThread->Yield();
 			}
 			break;
 			case SC_UserThreadExit:
@@ -175,7 +280,7 @@ void ExceptionHandler (ExceptionType which) {
 			{
 				DEBUG('a', "UserThreadJoin called by user program\n");
 				int tid = machine->ReadRegister(4);
-				UserThreadJoin(tid);
+				machine->WriteRegister(2, UserThreadJoin(tid));
 			}
 			break;
 			case SC_ForkExec:
@@ -189,13 +294,106 @@ void ExceptionHandler (ExceptionType which) {
 				delete buffer;
 			}
 			break;
+			case SC_Create:
+			{
+				DEBUG('a', "Create called by user program\n");
+				char buffer[MAX_STRING_SIZE];
+				copyStringFromMachine(machine->ReadRegister(4), buffer, MAX_STRING_SIZE);
+				if (!fileSystem->Create(buffer))
+					printf("[ERROR] Create: unable to create %s\n", buffer);
+			}
+			break;
+			case SC_Open:
+			{
+				DEBUG('a', "Open called by user program\n");
+				char buffer[MAX_STRING_SIZE];
+				copyStringFromMachine(machine->ReadRegister(4), buffer, MAX_STRING_SIZE);
+				OpenFile *file = fileSystem->Open(buffer);
+				int id = -1;
+				if (file != NULL) {
+					id = currentThread->space->AddOpenFile(file);
+					if (id < 0)
+						delete file;
+				}
+				machine->WriteRegister(2, id);
+			}
+			break;
+			case SC_Close:
+			{
+				DEBUG('a', "Close called by user program\n");
+				currentThread->space->CloseOpenFile(machine->ReadRegister(4));
+			}
+			break;
+			case SC_Mmap:
+			{
+				DEBUG('a', "Mmap called by user program\n");
+				int id = machine->ReadRegister(4);
+				int offset = machine->ReadRegister(5);
+				int length = machine->ReadRegister(6);
+				machine->WriteRegister(2, currentThread->space->Mmap(id, offset, length));
+			}
+			break;
+			case SC_Munmap:
+			{
+				DEBUG('a', "Munmap called by user program\n");
+				int addr = machine->ReadRegister(4);
+				machine->WriteRegister(2, currentThread->space->Munmap(addr));
+			}
+			break;
+			case SC_Sbrk:
+			{
+				DEBUG('a', "Sbrk called by user program\n");
+				int increment = machine->ReadRegister(4);
+				machine->WriteRegister(2, currentThread->space->Sbrk(increment));
+			}
+			break;
+			case SC_ShmCreate:
+			{
+				DEBUG('a', "ShmCreate called by user program\n");
+				int key = machine->ReadRegister(4);
+				int size = machine->ReadRegister(5);
+				machine->WriteRegister(2, currentThread->space->ShmCreate(key, size));
+			}
+			break;
+			case SC_ShmAttach:
+			{
+				DEBUG('a', "ShmAttach called by user program\n");
+				int key = machine->ReadRegister(4);
+				machine->WriteRegister(2, currentThread->space->ShmAttach(key));
+			}
+			break;
+			case SC_ShmDetach:
+			{
+				DEBUG('a', "ShmDetach called by user program\n");
+				int addr = machine->ReadRegister(4);
+				machine->WriteRegister(2, currentThread->space->ShmDetach(addr));
+			}
+			break;
 			default:
 				printf("Unexpected user mode exception %d %d\n", which, type);
 				ASSERT(FALSE);
 		}
+		UpdatePC();
+		return;
 	}
 
-	UpdatePC();
+	if (which == PageFaultException) {
+		// A page which is not loaded yet.  The faulting instruction is
+		// restarted when we return, so the pc must stay.  Otherwise a
+		// guard page, an address above the break or out of frames
+		int badVAddr = machine->ReadRegister(BadVAddrReg);
+		if (currentThread->space->HandlePageFault(badVAddr))
+			return;
+		printf("[ERROR] Page fault at 0x%x\n", badVAddr);
+	} else if (which == ReadOnlyException) {
+		// A store into the text of the program
+		printf("[ERROR] Write to read-only address 0x%x\n",
+		       machine->ReadRegister(BadVAddrReg));
+	} else {
+		printf("[ERROR] Unexpected user mode exception %d at pc 0x%x\n",
+		       which, machine->ReadRegister(PCReg));
+	}
+	KillFaultingThread();
 }
 
 
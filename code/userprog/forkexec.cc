@@ -2,8 +2,9 @@
 #include "addrspace.h"
 
 static void StartForkExec(int arg) {
+    // the machine and page table were given to the thread when it
+    // started, see ThreadRoot
     currentThread->space->InitRegisters();	// set the initial register values
-    currentThread->space->RestoreState();	// load page table register
     machine->Run();		// jump to the user progam
 }
 
@@ -26,19 +27,41 @@ int ForkExec(char *filename) {
 
     MajNbProc(1);
 
+    // With paging, memory is overcommitted while processes are suspended,
+    // new ones wait until it is not
+    loadControl->Admit(0);
     space = new AddrSpace (executable);
-    t->space = space;
-
-    delete executable;
-
-    if (space->IsStackFull()) {
-        printf("[ERROR] User stack is full!\n");
+    if (space->IsTooBig()) {
+        printf("[ERROR] %s is too big, %d pages!\n", filename, space->NumPages());
         delete space;
         delete t;
         MajNbProc(-1);
         return -1;
     }
 
+    // Not enough free frames: wait in the admission queue for processes
+    // to give some back, unless there will never be enough.  The space
+    // owns the executable, it is opened again for each try
+    while (space->IsStackFull()) {
+        int numPages = space->NumReservedPages();
+        delete space;
+        if (!loadControl->Admit(numPages)) {
+            printf("[ERROR] %s needs %d pages, it would never fit in memory!\n",
+                   filename, numPages);
+            delete t;
+            MajNbProc(-1);
+            return -1;
+        }
+        if ((executable = fileSystem->Open(filename)) == NULL) {
+            printf("[ERROR] Unable to open %s again!\n", filename);
+            delete t;
+            MajNbProc(-1);
+            return -1;
+        }
+        space = new AddrSpace (executable);
+    }
+    t->space = space;
+
     t->ForkExec(StartForkExec, 0);
 
     currentThread->Yield();
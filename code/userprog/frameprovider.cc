@@ -1,42 +1,458 @@
 #include "frameprovider.h"
 #include "sysdep.h"
 #include "synch.h"
+#include "system.h"
+#include "addrspace.h"
 
-static Semaphore *pageSem = new Semaphore("Page Semaphore", 1);
+// Held for writing to change the frame table or the free stack, for
+// reading to look at them.  It is not held during the I/O of an
+// eviction, see EvictFrame
+static RWLock *frameLock = new RWLock("frame table lock");
+
+// Signaled at the end of each eviction, for the threads waiting in
+// WaitEvicted
+static Semaphore *evictionDone = new Semaphore("eviction done", 0);
 
 FrameProvider::FrameProvider(int numPages) {
     bitMap = new BitMap(numPages);
     size = numPages;
+    randomPlacement = false;
+    paging = false;
+    clockHand = 0;
+
+    // Push the frames in reverse order so that, by default, the lowest
+    // numbered frames are handed out first
+    freeFrames = new int[numPages];
+    numFree = 0;
+    for (int i = numPages - 1; i >= 0; i--) {
+        freeFrames[numFree++] = i;
+    }
+
+    frameTable = new FrameEntry[numPages];
+    for (int i = 0; i < numPages; i++) {
+        frameTable[i].owner = NULL;
+        frameTable[i].ownerPid = -1;
+        frameTable[i].vpn = -1;
+        frameTable[i].leaked = false;
+        frameTable[i].referenced = false;
+        frameTable[i].lastUsed = 0;
+        frameTable[i].refs = 0;
+        frameTable[i].inTransit = false;
+    }
+    numEvictionWaiters = 0;
+    defaultLimit = 0;
+    numLimitFailures = 0;
+    numExhausted = 0;
+    numEvicted = 0;
 }
 
 FrameProvider::~FrameProvider() {
     delete bitMap;
+    delete [] freeFrames;
+    delete [] frameTable;
+}
+
+// Pops a frame off the free stack and marks it as used. In random placement
+// mode a random free frame is swapped to the top first. Must be called with
+// frameLock held for writing and numFree > 0
+int FrameProvider::PopFrame() {
+    if (randomPlacement) {
+        int i = Random() % numFree;
+        int tmp = freeFrames[i];
+        freeFrames[i] = freeFrames[numFree - 1];
+        freeFrames[numFree - 1] = tmp;
+    }
+
+    int page = freeFrames[--numFree];
+    bitMap->Mark(page);
+    frameTable[page].refs = 1;
+    return page;
+}
+
+// Checks the frame limit of the owner before charging it n more frames
+bool FrameProvider::CanCharge(AddrSpace *owner, int n) {
+    if (owner == NULL || owner->GetFrameLimit() <= 0) {
+        return true;
+    }
+    if (owner->NumResidentPages() + n <= owner->GetFrameLimit()) {
+        return true;
+    }
+    numLimitFailures++;
+    DEBUG('a', "Process %d hit its limit of %d frames\n",
+          owner->GetPid(), owner->GetFrameLimit());
+    return false;
+}
+
+// Saves the page in frame "page" so that the frame can be reused.  The
+// frame is marked in transit and frameLock is released for the I/O of
+// AddrSpace::EvictPage, so that the other users of the frame table do
+// not queue behind a swap write; meanwhile the page is invalid, so the
+// frame is neither stolen again nor released by its owner.  Must be
+// called with frameLock held for writing, it is held again on return.
+// Returns false if the page could not be saved
+bool FrameProvider::EvictFrame(int page) {
+    FrameEntry *e = &frameTable[page];
+    AddrSpace *owner = e->owner;
+
+    e->inTransit = true;
+    frameLock->ReleaseWrite();
+    bool saved = owner->EvictPage(e->vpn);
+    frameLock->AcquireWrite();
+    e->inTransit = false;
+    while (numEvictionWaiters > 0) {
+        numEvictionWaiters--;
+        evictionDone->V();
+    }
+    if (!saved) {
+        return false;
+    }
+
+    owner->ChargeFrames(-1);
+    e->owner = NULL;
+    e->ownerPid = -1;
+    e->vpn = -1;
+    e->referenced = false;
+    numEvicted++;
+    return true;
+}
+
+// Waits until no page in [firstVpn, firstVpn + n) of "space" is in
+// transit.  Must be called with frameLock held for writing
+void FrameProvider::WaitEvicted(AddrSpace *space, unsigned firstVpn, unsigned n) {
+    for (;;) {
+        bool busy = false;
+        for (int i = 0; i < size && !busy; i++) {
+            FrameEntry *e = &frameTable[i];
+            busy = e->inTransit && e->owner == space && (unsigned) e->vpn - firstVpn < n;
+        }
+        if (!busy) {
+            return;
+        }
+        numEvictionWaiters++;
+        frameLock->ReleaseWrite();
+        evictionDone->P();
+        frameLock->AcquireWrite();
+    }
 }
 
-// Returns the frame offset address if its able to find a free frame else returns NULL
-int FrameProvider::GetEmptyFrame() {
-    
-    pageSem->P();
-    if (bitMap->NumClear() <= 0) {
-        pageSem->V();
+// Second chance replacement: the clock hand clears the use bit of the
+// pages it passes, and evicts the first page not used since its last
+// pass.  Frames which are not mapped yet or in transit, and pages which
+// can not be saved, are skipped.  Must be called with frameLock held for
+// writing, which is released during the eviction
+int FrameProvider::StealFrame(AddrSpace *from) {
+    for (int scanned = 0; scanned < 2 * size; scanned++) {
+        int page = clockHand;
+        FrameEntry *e = &frameTable[page];
+        clockHand = (clockHand + 1) % size;
+
+        if (e->owner == NULL || e->leaked || e->inTransit
+            || (from != NULL && e->owner != from)) {
+            continue;
+        }
+        TranslationEntry *entry = e->owner->GetEntry(e->vpn);
+        if (entry == NULL || !entry->valid || (int) entry->physicalPage != page) {
+            continue;
+        }
+        if (e->referenced) {
+            e->referenced = false;
+            continue;
+        }
+        if (e->owner->TestAndClearUse(e->vpn) || !EvictFrame(page)) {
+            continue;
+        }
+        return page;
+    }
+    return -1;
+}
+
+// Evicts n pages and puts their frames back on the free stack. Must be
+// called with frameLock held for writing.  As the lock is released during
+// each eviction, other threads may have taken the frames on return
+bool FrameProvider::Reclaim(int n, AddrSpace *from) {
+    if (!paging) {
+        return false;
+    }
+    for (int i = 0; i < n; i++) {
+        int page = StealFrame(from);
+        if (page < 0) {
+            return false;
+        }
+        bitMap->Clear(page);
+        freeFrames[numFree++] = page;
+    }
+    return true;
+}
+
+// Returns the frame offset address if its able to find a free frame else returns -1
+// The frame is recorded as mapping page "vpn" of "owner". Without "mayEvict",
+// only a frame which is free already is returned
+int FrameProvider::GetEmptyFrame(AddrSpace *owner, int vpn, bool mayEvict) {
+
+    frameLock->AcquireWrite();
+    // The page may still be in transit to the page store
+    if (owner != NULL && vpn >= 0) {
+        WaitEvicted(owner, vpn, 1);
+    }
+    // At its limit, the owner gives up one of its own pages
+    if (mayEvict && owner != NULL && owner->GetFrameLimit() > 0
+        && owner->NumResidentPages() >= owner->GetFrameLimit()) {
+        Reclaim(1, owner);
+    }
+    if (!CanCharge(owner, 1)) {
+        frameLock->ReleaseWrite();
         return -1;
     }
+    while (numFree <= 0) {
+        if (!(mayEvict && Reclaim(1, NULL))) {
+            numExhausted++;
+            DEBUG('a', "Out of physical frames\n");
+            frameLock->ReleaseWrite();
+            return -1;
+        }
+    }
 
-    int page = bitMap->Find();
-    pageSem->V();
+    int page = PopFrame();
+    frameTable[page].owner = owner;
+    frameTable[page].ownerPid = owner != NULL ? owner->GetPid() : -1;
+    frameTable[page].vpn = vpn;
+    if (owner != NULL) {
+        owner->ChargeFrames(1);
+    }
+    frameLock->ReleaseWrite();
     return page;
 }
 
-// Unsets the particluar frame in the bitmap so that its available for other allocations
+// Reserves n frames at once and stores them in frames[]. Either all of them
+// are allocated or none is, so that an address space never ends up half built.
+// frames[i] is recorded as mapping page firstVpn + i of "owner"
+bool FrameProvider::GetEmptyFrames(int n, int *frames, AddrSpace *owner, int firstVpn) {
+
+    frameLock->AcquireWrite();
+    if (!CanCharge(owner, n)) {
+        frameLock->ReleaseWrite();
+        return false;
+    }
+    while (n > numFree) {
+        if (!Reclaim(n - numFree, NULL)) {
+            numExhausted++;
+            DEBUG('a', "Out of physical frames (%d wanted, %d free)\n", n, numFree);
+            frameLock->ReleaseWrite();
+            return false;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        int page = PopFrame();
+        frameTable[page].owner = owner;
+        frameTable[page].ownerPid = owner != NULL ? owner->GetPid() : -1;
+        frameTable[page].vpn = firstVpn + i;
+        frames[i] = page;
+    }
+    if (owner != NULL) {
+        owner->ChargeFrames(n);
+    }
+    frameLock->ReleaseWrite();
+    return true;
+}
+
+// The check is made with frameLock held: AcquireWrite may sleep, and two
+// racing releases of the same frame must not both pass it
+void FrameProvider::ShareFrame(int pageNum) {
+    frameLock->AcquireWrite();
+    if (pageNum < 0 || pageNum >= size || !bitMap->Test(pageNum)) {
+        frameLock->ReleaseWrite();
+        printf("[ERROR] Invalid Page number!\n");
+        return;
+    }
+    frameTable[pageNum].refs++;
+    frameLock->ReleaseWrite();
+}
+
+// Unsets the particluar frame in the bitmap and pushes it back on the free stack
 void FrameProvider::ReleaseFrame(int pageNum) {
-    if (!bitMap->Test(pageNum)) {
+    frameLock->AcquireWrite();
+    if (pageNum < 0 || pageNum >= size || !bitMap->Test(pageNum)) {
+        frameLock->ReleaseWrite();
         printf("[ERROR] Invalid Page number!\n");
         return;
     }
+    FrameEntry *e = &frameTable[pageNum];
+    ASSERT(!e->inTransit);  // its page is not valid
+    if (--e->refs > 0) {
+        frameLock->ReleaseWrite();
+        return;
+    }
+    if (e->owner != NULL && !e->leaked) {
+        e->owner->ChargeFrames(-1);
+    }
+    e->owner = NULL;
+    e->ownerPid = -1;
+    e->vpn = -1;
+    e->leaked = false;
+    e->referenced = false;
+
     bitMap->Clear(pageNum);
+    freeFrames[numFree++] = pageNum;
+    frameLock->ReleaseWrite();
+
+    loadControl->FramesReleased();
 }
 
-// Returns the num of available frames from bitmap
+// Returns the num of available frames.  Load control also asks from the
+// timer interrupt, with interrupts off, where it must not block: numFree
+// is then read without the lock, and may be stale if a thread is in the
+// middle of Reclaim
 int FrameProvider::NumAvailFrame() {
-    return bitMap->NumClear();
-}
\ No newline at end of file
+    if (interrupt->getLevel() == IntOff) {
+        return numFree;
+    }
+    frameLock->AcquireRead();
+    int n = numFree;
+    frameLock->ReleaseRead();
+    return n;
+}
+
+// Returns the num of frames mapped by "space", as the frame table sees them
+int FrameProvider::NumFramesOwned(AddrSpace *space) {
+    int n = 0;
+
+    frameLock->AcquireRead();
+    for (int i = 0; i < size; i++) {
+        if (frameTable[i].owner == space && !frameTable[i].leaked) {
+            n++;
+        }
+    }
+    frameLock->ReleaseRead();
+    return n;
+}
+
+// Returns the num of frames still owned by deleted address spaces
+int FrameProvider::NumLeakedFrames() {
+    int n = 0;
+
+    frameLock->AcquireRead();
+    for (int i = 0; i < size; i++) {
+        if (frameTable[i].leaked) {
+            n++;
+        }
+    }
+    frameLock->ReleaseRead();
+    return n;
+}
+
+void FrameProvider::SetPaging(bool enabled) {
+    paging = enabled;
+}
+
+bool FrameProvider::GetPaging() {
+    return paging;
+}
+
+// Called on timer interrupts, so it must not block: moves the use bits of
+// the mapped pages into the frame table (the clock takes both into
+// account), and adds to the working set of each running space its frames
+// referenced during the last "window" samples
+void FrameProvider::SampleUseBits(int now, int window) {
+    for (int i = 0; i < size; i++) {
+        FrameEntry *e = &frameTable[i];
+        if (e->owner == NULL || e->leaked || e->owner->IsSuspended()) {
+            continue;
+        }
+        TranslationEntry *entry = e->owner->GetEntry(e->vpn);
+        if (entry == NULL || !entry->valid || (int) entry->physicalPage != i) {
+            continue;
+        }
+        if (e->owner->TestAndClearUse(e->vpn)) {
+            e->referenced = true;
+            e->lastUsed = now;
+        }
+        if (now - e->lastUsed < window) {
+            e->owner->SetWorkingSet(e->owner->GetWorkingSet() + 1);
+        }
+    }
+}
+
+// Evicts every page of "space", without giving them a second chance
+void FrameProvider::EvictSpace(AddrSpace *space) {
+    int n = 0;
+
+    frameLock->AcquireWrite();
+    for (int i = 0; i < size; i++) {
+        FrameEntry *e = &frameTable[i];
+        if (e->owner != space || e->leaked || e->inTransit) {
+            continue;
+        }
+        TranslationEntry *entry = space->GetEntry(e->vpn);
+        if (entry == NULL || !entry->valid || (int) entry->physicalPage != i
+            || !EvictFrame(i)) {
+            continue;
+        }
+        bitMap->Clear(i);
+        freeFrames[numFree++] = i;
+        n++;
+    }
+    frameLock->ReleaseWrite();
+
+    DEBUG('a', "Swapped out %d pages of process %d\n", n, space->GetPid());
+    loadControl->FramesReleased();
+}
+
+// Waits for the evictions of the pages [firstVpn, firstVpn + n) of
+// "space" in progress, before they are unmapped or the space deleted
+void FrameProvider::WaitForEvictions(AddrSpace *space, unsigned firstVpn, unsigned n) {
+    frameLock->AcquireWrite();
+    WaitEvicted(space, firstVpn, n);
+    frameLock->ReleaseWrite();
+}
+
+// Random placement scatters the frames of an address space over the whole
+// physical memory, which helps catching code that assumes contiguous frames
+void FrameProvider::SetRandomPlacement(bool random) {
+    randomPlacement = random;
+}
+
+// Sets the frame limit given to new address spaces (0 means unlimited)
+void FrameProvider::SetDefaultFrameLimit(int limit) {
+    defaultLimit = limit;
+}
+
+int FrameProvider::GetDefaultFrameLimit() {
+    return defaultLimit;
+}
+
+// Called when an address space is deleted, after it released its frames.
+// Anything it still owns at that point is lost for good: flag it so that
+// it shows up in the report at Halt
+void FrameProvider::SpaceDestroyed(AddrSpace *space) {
+    frameLock->AcquireWrite();
+    for (int i = 0; i < size; i++) {
+        if (frameTable[i].owner == space && !frameTable[i].leaked) {
+            frameTable[i].leaked = true;
+            DEBUG('a', "Frame %d leaked by process %d (vpn %d)\n",
+                  i, frameTable[i].ownerPid, frameTable[i].vpn);
+        }
+    }
+    frameLock->ReleaseWrite();
+}
+
+// Prints frame usage, and lists the frames still owned by deleted address spaces
+void FrameProvider::Print() {
+    int numLeaked = 0;
+
+    frameLock->AcquireRead();
+    for (int i = 0; i < size; i++) {
+        if (frameTable[i].leaked) {
+            if (numLeaked == 0) {
+                printf("Leaked frames:\n");
+            }
+            printf("\tframe %d, owned by dead process %d at vpn %d\n",
+                   i, frameTable[i].ownerPid, frameTable[i].vpn);
+            numLeaked++;
+        }
+    }
+    printf("Frames: total %d, free %d, leaked %d, refused by limit %d, out of memory %d, evicted %d\n",
+           size, numFree, numLeaked, numLimitFailures, numExhausted, numEvicted);
+    frameLock->ReleaseRead();
+    frameLock->Print();
+}
@@ -3,17 +3,80 @@
 
 #include "bitmap.h"
 
+class AddrSpace;
+
+// Reverse mapping of a physical frame: which address space owns it, and
+// at which virtual page. ownerPid is kept so that a frame can still be
+// reported once its owner has been deleted.
+typedef struct frameEntry_t {
+    AddrSpace *owner;   // NULL if the frame is free or not owned
+    int ownerPid;
+    int vpn;
+    bool leaked;        // owner was deleted without releasing the frame
+    bool referenced;    // use bit seen set by the last working set sample
+    int lastUsed;       // last sample which saw the page referenced
+    int refs;           // page tables mapping it, more than one for
+                        // shared memory
+    bool inTransit;     // its page is being saved by an eviction
+} FrameEntry;
+
+// Physical frames are handed out from a stack of free frame numbers, so
+// that allocating, releasing and counting frames are all O(1).  The
+// bitmap is only kept to catch invalid or double releases.  A frame of
+// shared memory is mapped by several address spaces, and only goes
+// back to the stack once each of them released it.
+//
+// With paging enabled, a frame is taken from another page when none is
+// free, or from the owner itself when it reached its frame limit.  The
+// victim is chosen by a clock over the frame table, and handed to its
+// address space to be saved (see AddrSpace::EvictPage).  The frame is
+// in transit meanwhile, and the frame table lock is not held during the
+// I/O: a fault on the page waits in GetEmptyFrame for it to be saved.
 class FrameProvider {
     public:
         FrameProvider(int numPages);    // Constructor
         ~FrameProvider();   // Destructor
-        int GetEmptyFrame();    // to retrieve a free frame which is available
-        void ReleaseFrame(int pageNum); // to release an allocated frame
+        int GetEmptyFrame(AddrSpace *owner = NULL, int vpn = -1, bool mayEvict = true);    // to retrieve a free frame which is available
+        bool GetEmptyFrames(int n, int *frames, AddrSpace *owner = NULL, int firstVpn = 0); // to reserve n frames at once, or none at all
+        void ReleaseFrame(int pageNum); // to drop a reference, the frame is freed with the last one
+        void ShareFrame(int pageNum); // to take one more reference on an allocated frame
         int NumAvailFrame(); // to get the num of available frames for allocation
-    
+        int NumFramesOwned(AddrSpace *space); // to get the num of frames mapped by space
+        int NumLeakedFrames(); // to get the num of frames owned by deleted spaces
+        void SetRandomPlacement(bool random); // to hand out frames in random order (testing)
+        void SetPaging(bool enabled); // to evict pages when frames run out
+        bool GetPaging();
+        void SampleUseBits(int now, int window); // to count the working set of each space
+        void EvictSpace(AddrSpace *space); // to swap out all the pages of a space
+        void WaitForEvictions(AddrSpace *space, unsigned firstVpn = 0, unsigned n = ~0u); // to wait for the pages in transit
+
+        void SetDefaultFrameLimit(int limit); // per-process frame limit, 0 means unlimited
+        int GetDefaultFrameLimit();
+        void SpaceDestroyed(AddrSpace *space); // to flag the frames a deleted space still owns
+        void Print(); // to report frame usage and leaked frames
+
     private:
+        int PopFrame(); // to take one frame off the free stack
+        bool CanCharge(AddrSpace *owner, int n); // is owner allowed n more frames?
+        bool Reclaim(int n, AddrSpace *from); // to evict n pages, of "from" only if not NULL
+        int StealFrame(AddrSpace *from); // to evict the page chosen by the clock
+        bool EvictFrame(int page); // to save the page of a frame, without the lock during the I/O
+        void WaitEvicted(AddrSpace *space, unsigned firstVpn, unsigned n); // to wait until none of those pages is in transit
+
         BitMap *bitMap;
+        int *freeFrames;    // stack of free frame numbers
+        int numFree;        // number of entries in freeFrames
         int size;
+        bool randomPlacement;
+        bool paging;
+        int clockHand;
+
+        FrameEntry *frameTable; // owner of each frame
+        int defaultLimit;
+        int numLimitFailures;   // allocations refused because of a limit
+        int numExhausted;       // allocations refused because memory is full
+        int numEvicted;         // pages evicted to free a frame
+        int numEvictionWaiters; // threads waiting in WaitEvicted
 };
 
-#endif /* USERPROG_FRAMEPROVIDER_H_ */
\ No newline at end of file
+#endif /* USERPROG_FRAMEPROVIDER_H_ */
@@ -0,0 +1,117 @@
+#include "futex.h"
+#include "system.h"
+#include "addrspace.h"
+
+FutexTable::FutexTable() {
+    for (int i = 0; i < NumFutexBuckets; i++) {
+        buckets[i] = NULL;
+    }
+    numWaits = 0;
+    numWakes = 0;
+}
+
+FutexTable::~FutexTable() {
+    for (int i = 0; i < NumFutexBuckets; i++) {
+        ASSERT(buckets[i] == NULL);
+    }
+}
+
+// Finds the queue of the word at "addr".  A word of shared memory stays
+// in the same frame, the others are found by their virtual address.
+void FutexTable::Key(int addr, AddrSpace **space, int *key) {
+    AddrSpace *current = currentThread->space;
+    unsigned vpn = (unsigned) addr / PageSize;
+
+    if (current->InSharedMemory(vpn)) {
+        *space = NULL;
+        *key = current->GetEntry(vpn)->physicalPage * PageSize + addr % PageSize;
+    } else {
+        *space = current;
+        *key = addr;
+    }
+}
+
+// Reads the word at "addr" with interrupts off, so that nobody can wake
+// the queue between the check and the sleep: the page is brought back
+// first if it is not resident.  Returns the previous interrupt level,
+// interrupts are left off.
+static bool ReadWord(int addr, int *value, IntStatus *oldLevel) {
+    for (;;) {
+        *oldLevel = interrupt->SetLevel(IntOff);
+        TranslationEntry *entry = currentThread->space->GetEntry((unsigned) addr / PageSize);
+        if (entry != NULL && entry->valid) {
+            int physAddr = entry->physicalPage * PageSize + addr % PageSize;
+            *value = WordToHost(*(unsigned int *) &machine->mainMemory[physAddr]);
+            return true;
+        }
+        (void) interrupt->SetLevel(*oldLevel);
+        if (!machine->ReadMem(addr, 4, value) && !machine->ReadMem(addr, 4, value)) {
+            return false;
+        }
+    }
+}
+
+int FutexTable::Wait(int addr, int expected) {
+    AddrSpace *space;
+    IntStatus oldLevel;
+    int key, value;
+
+    if (addr & 0x3) {
+        printf("[ERROR] FutexWait: unaligned address 0x%x\n", addr);
+        return -1;
+    }
+    if (!ReadWord(addr, &value, &oldLevel)) {
+        printf("[ERROR] FutexWait: invalid address 0x%x\n", addr);
+        return -1;
+    }
+    if (value != expected) {
+        (void) interrupt->SetLevel(oldLevel);
+        return -1;
+    }
+
+    Key(addr, &space, &key);
+    FutexWaiter *w = new FutexWaiter;
+    w->space = space;
+    w->key = key;
+    w->thread = currentThread;
+    w->next = NULL;
+    FutexWaiter **link = &buckets[(unsigned) key / 4 % NumFutexBuckets];
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    *link = w;
+    numWaits++;
+
+    currentThread->Sleep();
+    (void) interrupt->SetLevel(oldLevel);
+    return 0;
+}
+
+int FutexTable::Wake(int addr, int n) {
+    AddrSpace *space;
+    int key, woken = 0;
+
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Key(addr, &space, &key);
+    FutexWaiter **link = &buckets[(unsigned) key / 4 % NumFutexBuckets];
+    while (*link != NULL && woken < n) {
+        FutexWaiter *w = *link;
+        if (w->space != space || w->key != key) {
+            link = &w->next;
+            continue;
+        }
+        *link = w->next;
+        scheduler->ReadyToRun(w->thread);
+        delete w;
+        woken++;
+    }
+    numWakes += woken;
+    (void) interrupt->SetLevel(oldLevel);
+    return woken;
+}
+
+void FutexTable::Print() {
+    if (numWaits > 0) {
+        printf("Futex: %d waits, %d wakes\n", numWaits, numWakes);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef USERPROG_FUTEX_H_
+#define USERPROG_FUTEX_H_
+
+#include "thread.h"
+
+class AddrSpace;
+
+#define NumFutexBuckets 64
+
+// A thread sleeping in FutexWait
+typedef struct futexWaiter_t {
+    AddrSpace *space;   // NULL for a word of shared memory
+    int key;            // its physical address then, else its virtual one
+    Thread *thread;
+    struct futexWaiter_t *next; // in the hash bucket, oldest first
+} FutexWaiter;
+
+// Wait queues for the user synchronization library (test/usync.c), which
+// only calls the kernel when a lock or a condition is contended.
+//
+// Threads wait on a word of user memory.  The queues are hashed by its
+// physical address when it is shared memory, so that processes attaching
+// the same segment meet, and by the address space and virtual address
+// otherwise: the frame of a private page changes when it is evicted.
+class FutexTable {
+    public:
+        FutexTable();
+        ~FutexTable();
+        int Wait(int addr, int expected); // to sleep if *addr == expected, 0 once woken, -1 if it differed
+        int Wake(int addr, int n); // to wake up to n threads waiting on addr, returns how many
+        void Print(); // to report how often threads had to wait
+
+    private:
+        void Key(int addr, AddrSpace **space, int *key);
+
+        FutexWaiter *buckets[NumFutexBuckets];
+        int numWaits;       // threads put to sleep
+        int numWakes;       // threads woken up
+};
+
+#endif /* USERPROG_FUTEX_H_ */
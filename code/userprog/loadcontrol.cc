@@ -0,0 +1,176 @@
+#include "loadcontrol.h"
+#include "system.h"
+#include "addrspace.h"
+
+LoadControl::LoadControl() {
+    maxSpaces = 8;
+    spaces = new AddrSpace *[maxSpaces];
+    numSpaces = 0;
+    numSamples = 0;
+
+    waiters = NULL;
+    numQueued = 0;
+    totalWait = 0;
+    maxWait = 0;
+    numSuspensions = 0;
+    numResumptions = 0;
+}
+
+LoadControl::~LoadControl() {
+    delete [] spaces;
+}
+
+void LoadControl::AddSpace(AddrSpace *space) {
+    if (numSpaces == maxSpaces) {
+        AddrSpace **bigger = new AddrSpace *[2 * maxSpaces];
+        for (int i = 0; i < numSpaces; i++) {
+            bigger[i] = spaces[i];
+        }
+        delete [] spaces;
+        spaces = bigger;
+        maxSpaces *= 2;
+    }
+    spaces[numSpaces++] = space;
+}
+
+void LoadControl::RemoveSpace(AddrSpace *space) {
+    for (int i = 0; i < numSpaces; i++) {
+        if (spaces[i] == space) {
+            spaces[i] = spaces[--numSpaces];
+            break;
+        }
+    }
+    // its working set no longer counts
+    Balance();
+}
+
+bool LoadControl::CanAdmit(int numPages) {
+    for (int i = 0; i < numSpaces; i++) {
+        if (spaces[i]->IsSuspended()) {
+            return false;
+        }
+    }
+    return frameProvider->NumAvailFrame() >= numPages;
+}
+
+// Called by ForkExec. Processes are admitted in the order they arrived,
+// so that a big one is not delayed for ever by smaller ones
+bool LoadControl::Admit(int numPages) {
+    int mine = currentThread->space != NULL ? currentThread->space->NumResidentPages() : 0;
+    int limit = frameProvider->GetDefaultFrameLimit();
+    if (numPages > NumPhysPages - mine || (limit > 0 && numPages > limit)) {
+        // would not fit even if everybody else exited
+        return false;
+    }
+    if (waiters == NULL && CanAdmit(numPages)) {
+        return true;
+    }
+
+    AdmissionWaiter *w = new AdmissionWaiter;
+    w->numPages = numPages;
+    w->since = stats->totalTicks;
+    w->sem = new Semaphore("Admission", 0);
+    w->next = NULL;
+
+    AdmissionWaiter **last = &waiters;
+    while (*last != NULL) {
+        last = &(*last)->next;
+    }
+    *last = w;
+    numQueued++;
+    DEBUG('a', "ForkExec queued, %d pages wanted\n", numPages);
+
+    w->sem->P();
+
+    long long wait = stats->totalTicks - w->since;
+    totalWait += wait;
+    if (wait > maxWait) {
+        maxWait = wait;
+    }
+    delete w->sem;
+    delete w;
+    return true;
+}
+
+void LoadControl::FramesReleased() {
+    while (waiters != NULL && CanAdmit(waiters->numPages)) {
+        AdmissionWaiter *w = waiters;
+        waiters = w->next;
+        w->sem->V();
+    }
+}
+
+// Estimates the working sets: the pages referenced since the last sample
+// are marked by the frame provider, which then counts, for each process,
+// the frames referenced during the last WorkingSetWindow samples.  The
+// working set of a suspended process is the one it had when suspended
+void LoadControl::Sample() {
+    numSamples++;
+    for (int i = 0; i < numSpaces; i++) {
+        if (!spaces[i]->IsSuspended()) {
+            spaces[i]->SetWorkingSet(0);
+        }
+    }
+    frameProvider->SampleUseBits(numSamples, WorkingSetWindow);
+    Balance();
+}
+
+// While the working sets of the running processes do not fit in memory,
+// suspend the largest one, unless it is the last one.  Resume the
+// smallest suspended process when its working set fits again, with some
+// headroom to avoid suspending it again right away
+void LoadControl::Balance() {
+    int active = 0;
+    int demand = 0;
+    for (int i = 0; i < numSpaces; i++) {
+        if (!spaces[i]->IsSuspended()) {
+            active++;
+            demand += spaces[i]->GetWorkingSet();
+        }
+    }
+
+    while (demand > NumPhysPages && active > 1) {
+        AddrSpace *victim = NULL;
+        for (int i = 0; i < numSpaces; i++) {
+            if (!spaces[i]->IsSuspended()
+                && (victim == NULL || spaces[i]->GetWorkingSet() > victim->GetWorkingSet())) {
+                victim = spaces[i];
+            }
+        }
+        DEBUG('a', "Thrashing (%d pages wanted), suspending process %d\n",
+              demand, victim->GetPid());
+        victim->Suspend();
+        numSuspensions++;
+        demand -= victim->GetWorkingSet();
+        active--;
+    }
+
+    for (;;) {
+        AddrSpace *next = NULL;
+        for (int i = 0; i < numSpaces; i++) {
+            if (spaces[i]->IsSuspended()
+                && (next == NULL || spaces[i]->GetWorkingSet() < next->GetWorkingSet())) {
+                next = spaces[i];
+            }
+        }
+        if (next == NULL
+            || (active > 0 && demand + next->GetWorkingSet() > NumPhysPages * 7 / 8)) {
+            break;
+        }
+        DEBUG('a', "Resuming process %d\n", next->GetPid());
+        next->Resume();
+        numResumptions++;
+        demand += next->GetWorkingSet();
+        active++;
+    }
+
+    FramesReleased();
+}
+
+void LoadControl::Print() {
+    if (numQueued == 0 && numSuspensions == 0) {
+        return;
+    }
+    printf("Load control: queued %d, wait ticks total %lld, max %lld, suspended %d, resumed %d\n",
+           numQueued, totalWait, maxWait, numSuspensions, numResumptions);
+}
@@ -0,0 +1,60 @@
+#ifndef USERPROG_LOADCONTROL_H_
+#define USERPROG_LOADCONTROL_H_
+
+#include "synch.h"
+
+class AddrSpace;
+
+// Pages referenced within this many samples are part of a working set
+#define WorkingSetWindow 4
+
+// A process waiting in ForkExec to be admitted
+typedef struct admissionWaiter_t {
+    int numPages;       // frames it needs, 0 if it may page
+    long long since;    // when it started to wait
+    Semaphore *sem;
+    struct admissionWaiter_t *next;
+} AdmissionWaiter;
+
+// Keeps the memory demand of the user processes within what the machine
+// has, in two ways:
+//
+// - ForkExec waits in a FIFO queue, instead of failing, until enough
+//   frames are free for the new process or, with paging, until no
+//   process is suspended any more.
+//
+// - With paging, the working set of each process is estimated from the
+//   use bits, sampled on timer interrupts.  When the working sets no
+//   longer fit in memory, the largest process is suspended and swapped
+//   out; it is resumed once its working set fits again.
+class LoadControl {
+    public:
+        LoadControl();
+        ~LoadControl();
+
+        void AddSpace(AddrSpace *space); // a process was created
+        void RemoveSpace(AddrSpace *space); // a process is being deleted
+
+        bool Admit(int numPages); // to wait until numPages frames can be given, false if they never can
+        void FramesReleased(); // to admit waiting processes
+        void Sample(); // called on timer interrupts
+        void Print(); // to report admission waits and suspensions
+
+    private:
+        void Balance(); // to suspend or resume processes
+        bool CanAdmit(int numPages);
+
+        AddrSpace **spaces; // live processes
+        int numSpaces;
+        int maxSpaces;
+        int numSamples;
+
+        AdmissionWaiter *waiters; // FIFO, oldest first
+        int numQueued;
+        long long totalWait;
+        long long maxWait;
+        int numSuspensions;
+        int numResumptions;
+};
+
+#endif /* USERPROG_LOADCONTROL_H_ */
@@ -0,0 +1,103 @@
+#include "lzcodec.h"
+
+#define HashBits 12
+
+// Hash of the first 3 bytes at "p"
+static inline unsigned Hash(const unsigned char *p) {
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - HashBits);
+}
+
+// Appends the literal run in[0..n) to out[o..], in chunks of 128 bytes
+static int PutLiterals(const unsigned char *in, int n, unsigned char *out, int o, int maxSize) {
+    while (n > 0) {
+        int chunk = n > 128 ? 128 : n;
+        if (o + 1 + chunk > maxSize) {
+            return -1;
+        }
+        out[o++] = chunk - 1;
+        for (int i = 0; i < chunk; i++) {
+            out[o++] = in[i];
+        }
+        in += chunk;
+        n -= chunk;
+    }
+    return o;
+}
+
+// Greedy parse: at each position, the last position with the same hash is
+// the only match candidate, which keeps compression linear in "size"
+int LzCompress(const char *src, int size, char *dst, int maxSize) {
+    const unsigned char *in = (const unsigned char *) src;
+    unsigned char *out = (unsigned char *) dst;
+    int head[1 << HashBits];
+    int pos = 0, literals = 0, o = 0;
+
+    for (int i = 0; i < (1 << HashBits); i++) {
+        head[i] = -1;
+    }
+
+    while (pos + LzMinMatch <= size) {
+        unsigned h = Hash(in + pos);
+        int candidate = head[h];
+        int len = 0;
+
+        head[h] = pos;
+        if (candidate >= 0 && pos - candidate <= LzMaxDistance) {
+            while (len < LzMaxMatch && pos + len < size
+                   && in[candidate + len] == in[pos + len]) {
+                len++;
+            }
+        }
+        if (len < LzMinMatch) {
+            pos++;
+            continue;
+        }
+
+        o = PutLiterals(in + literals, pos - literals, out, o, maxSize);
+        if (o < 0 || o + 3 > maxSize) {
+            return -1;
+        }
+        int distance = pos - candidate;
+        out[o++] = 0x80 | (len - LzMinMatch);
+        out[o++] = distance >> 8;
+        out[o++] = distance & 0xff;
+        pos += len;
+        literals = pos;
+    }
+    return PutLiterals(in + literals, size - literals, out, o, maxSize);
+}
+
+int LzDecompress(const char *src, int size, char *dst, int maxSize) {
+    const unsigned char *in = (const unsigned char *) src;
+    unsigned char *out = (unsigned char *) dst;
+    int i = 0, o = 0;
+
+    while (i < size) {
+        int token = in[i++];
+        if (token < 0x80) {
+            int n = token + 1;
+            if (i + n > size || o + n > maxSize) {
+                return -1;
+            }
+            while (n-- > 0) {
+                out[o++] = in[i++];
+            }
+        } else {
+            if (i + 2 > size) {
+                return -1;
+            }
+            int n = (token & 0x7f) + LzMinMatch;
+            int distance = in[i] << 8 | in[i + 1];
+            i += 2;
+            if (distance == 0 || distance > o || o + n > maxSize) {
+                return -1;
+            }
+            // byte by byte, the copy may overlap its own output
+            while (n-- > 0) {
+                out[o] = out[o - distance];
+                o++;
+            }
+        }
+    }
+    return o;
+}
@@ -0,0 +1,30 @@
+#ifndef USERPROG_LZCODEC_H_
+#define USERPROG_LZCODEC_H_
+
+// A small LZ77 codec, simple and fast enough to compress pages on the fly.
+//
+// The compressed stream is a sequence of tokens:
+//   0x00-0x7f  literal run of (token + 1) bytes, which follow the token
+//   0x80-0xff  copy of (token & 0x7f) + LzMinMatch bytes, starting at the
+//              distance given by the next two bytes (big endian)
+#define LzMinMatch      4       // a copy takes 3 bytes, shorter ones
+                                // would not pay for themselves
+#define LzMaxMatch      (0x7f + LzMinMatch)
+#define LzMaxDistance   0xffff
+
+// Worst case size of the compressed form of "n" bytes
+#define LzMaxCompressedSize(n)  ((n) + ((n) + 127) / 128)
+
+// Both return the size of the output, or -1 if it does not fit in
+// "maxSize" bytes (or, for LzDecompress, if "in" is corrupted).  C
+// linkage, so that coff2noff, written in C, uses this very encoder
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern int LzCompress(const char *in, int size, char *out, int maxSize);
+extern int LzDecompress(const char *in, int size, char *out, int maxSize);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USERPROG_LZCODEC_H_ */
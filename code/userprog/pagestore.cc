@@ -0,0 +1,211 @@
+#include "pagestore.h"
+#include "system.h"
+#include "lzcodec.h"
+
+#include <strings.h>
+
+static char swapFileName[] = "SWAP";
+
+PageStore::PageStore(int size) {
+    for (int i = 0; i < NumStoreBuckets; i++) {
+        buckets[i] = NULL;
+    }
+    poolSize = size;
+    poolUsed = 0;
+    swapFile = NULL;
+    swapSlots = new BitMap(NumSwapSlots);
+
+    numZero = numCompressed = numSwapped = 0;
+    bytesIn = bytesOut = 0;
+    numZeroHits = numPoolHits = numSwapHits = 0;
+}
+
+PageStore::~PageStore() {
+    for (int i = 0; i < NumStoreBuckets; i++) {
+        while (buckets[i] != NULL) {
+            StoredPage *p = buckets[i];
+            buckets[i] = p->next;
+            delete [] p->data;
+            delete p;
+        }
+    }
+    delete swapFile;
+    delete swapSlots;
+}
+
+// Returns the link pointing to the page "vpn" of "space", or to the NULL
+// ending its bucket if it is not stored
+StoredPage **PageStore::Lookup(AddrSpace *space, unsigned vpn) {
+    unsigned h = (vpn ^ ((unsigned long) space >> 4)) % NumStoreBuckets;
+    StoredPage **p = &buckets[h];
+    while (*p != NULL && ((*p)->space != space || (*p)->vpn != vpn)) {
+        p = &(*p)->next;
+    }
+    return p;
+}
+
+// Writes a page to a free slot of the swap file
+int PageStore::SwapOut(const char *page) {
+    if (swapFile == NULL) {
+        fileSystem->Create(swapFileName);
+        OpenFile *file = fileSystem->Open(swapFileName);
+        // another eviction may have opened it during the disk accesses
+        if (swapFile == NULL) {
+            swapFile = file;
+        } else {
+            delete file;
+        }
+        if (swapFile == NULL) {
+            printf("[ERROR] Unable to open the swap file\n");
+            return -1;
+        }
+    }
+
+    int slot = swapSlots->Find();
+    if (slot < 0) {
+        return -1;
+    }
+    if (swapFile->WriteAt(page, PageSize, slot * PageSize) != PageSize) {
+        swapSlots->Clear(slot);
+        return -1;
+    }
+    return slot;
+}
+
+bool PageStore::Store(AddrSpace *space, unsigned vpn, const char *page) {
+    StoredPage **link = Lookup(space, vpn);
+    ASSERT(*link == NULL);
+
+    StoredPage *p = new StoredPage;
+    p->space = space;
+    p->vpn = vpn;
+    p->data = NULL;
+    p->size = 0;
+    p->slot = -1;
+
+    int i = 0;
+    while (i < PageSize && page[i] == 0) {
+        i++;
+    }
+
+    char buffer[LzMaxCompressedSize(PageSize)];
+    int size = -1;
+    if (i < PageSize) {
+        size = LzCompress(page, PageSize, buffer, MaxCompressedSize);
+    }
+
+    if (i == PageSize) {
+        p->kind = ZERO_PAGE;
+        numZero++;
+    } else if (size > 0 && poolUsed + size <= poolSize) {
+        p->kind = COMPRESSED_PAGE;
+        p->data = new char[size];
+        p->size = size;
+        bcopy(buffer, p->data, size);
+        poolUsed += size;
+        bytesIn += PageSize;
+        bytesOut += size;
+        numCompressed++;
+    } else {
+        p->kind = SWAPPED_PAGE;
+        p->slot = SwapOut(page);
+        if (p->slot < 0) {
+            delete p;
+            return false;
+        }
+        numSwapped++;
+    }
+
+    // Looked up again, SwapOut may have let another thread in
+    link = Lookup(space, vpn);
+    p->next = *link;
+    *link = p;
+    DEBUG('a', "Stored page %d of process %d (kind %d, %d bytes)\n",
+          vpn, space->GetPid(), p->kind, p->size);
+    return true;
+}
+
+bool PageStore::Load(AddrSpace *space, unsigned vpn, char *page, StoredPageKind *kind) {
+    StoredPage **link = Lookup(space, vpn);
+    StoredPage *p = *link;
+    if (p == NULL) {
+        return false;
+    }
+    *link = p->next;
+    if (kind != NULL) {
+        *kind = p->kind;
+    }
+
+    switch (p->kind) {
+        case ZERO_PAGE:
+            bzero(page, PageSize);
+            numZeroHits++;
+            break;
+        case COMPRESSED_PAGE:
+            if (LzDecompress(p->data, p->size, page, PageSize) != PageSize) {
+                printf("[ERROR] Corrupted compressed page %d\n", vpn);
+                ASSERT(FALSE);
+            }
+            poolUsed -= p->size;
+            numPoolHits++;
+            break;
+        case SWAPPED_PAGE:
+            swapFile->ReadAt(page, PageSize, p->slot * PageSize);
+            swapSlots->Clear(p->slot);
+            numSwapHits++;
+            break;
+    }
+    delete [] p->data;
+    delete p;
+    return true;
+}
+
+void PageStore::Discard(AddrSpace *space) {
+    for (int i = 0; i < NumStoreBuckets; i++) {
+        StoredPage **link = &buckets[i];
+        while (*link != NULL) {
+            StoredPage *p = *link;
+            if (p->space != space) {
+                link = &p->next;
+                continue;
+            }
+            *link = p->next;
+            Free(p);
+        }
+    }
+}
+
+void PageStore::Discard(AddrSpace *space, unsigned vpn) {
+    StoredPage **link = Lookup(space, vpn);
+    StoredPage *p = *link;
+    if (p != NULL) {
+        *link = p->next;
+        Free(p);
+    }
+}
+
+// Gives back the room taken by a page which is not needed any more
+void PageStore::Free(StoredPage *p) {
+    if (p->kind == COMPRESSED_PAGE) {
+        poolUsed -= p->size;
+    } else if (p->kind == SWAPPED_PAGE) {
+        swapSlots->Clear(p->slot);
+    }
+    delete [] p->data;
+    delete p;
+}
+
+void PageStore::Print() {
+    int stored = numZero + numCompressed + numSwapped;
+    int loaded = numZeroHits + numPoolHits + numSwapHits;
+    if (stored == 0) {
+        return;
+    }
+
+    printf("Page store: stored %d (zero %d, compressed %d, swapped %d), compression ratio %.2f\n",
+           stored, numZero, numCompressed, numSwapped,
+           bytesOut > 0 ? (double) bytesIn / bytesOut : 0.0);
+    printf("Page store: loaded %d, hit rate %d%% (zero %d, compressed %d, swapped %d)\n",
+           loaded, loaded > 0 ? 100 * (numZeroHits + numPoolHits) / loaded : 0,
+           numZeroHits, numPoolHits, numSwapHits);
+}
@@ -0,0 +1,63 @@
+#ifndef USERPROG_PAGESTORE_H_
+#define USERPROG_PAGESTORE_H_
+
+#include "bitmap.h"
+#include "openfile.h"
+
+class AddrSpace;
+
+#define NumStoreBuckets 256
+#define NumSwapSlots    4096    // pages of the swap file
+
+// A page is only kept compressed if it saves at least a quarter of it
+#define MaxCompressedSize (PageSize * 3 / 4)
+
+enum StoredPageKind { ZERO_PAGE, COMPRESSED_PAGE, SWAPPED_PAGE };
+
+typedef struct storedPage_t {
+    AddrSpace *space;
+    unsigned vpn;
+    StoredPageKind kind;
+    char *data;         // compressed bytes (COMPRESSED_PAGE)
+    int size;           // number of bytes in data
+    int slot;           // page of the swap file (SWAPPED_PAGE)
+    struct storedPage_t *next;  // in the hash bucket
+} StoredPage;
+
+// Backing store of the pages evicted from physical memory.  Evicted pages
+// are compressed into a pool kept in host memory, and a page of zeros is
+// only recorded as such.  Only the pages which do not compress well, or
+// which do not fit in the pool any more, are written to the swap file,
+// at the price of a disk access each way.
+class PageStore {
+    public:
+        PageStore(int poolSize);    // poolSize bytes of compressed pages
+        ~PageStore();
+        bool Store(AddrSpace *space, unsigned vpn, const char *page); // false if there is no room left
+        bool Load(AddrSpace *space, unsigned vpn, char *page, StoredPageKind *kind = NULL); // false if the page is not stored
+        void Discard(AddrSpace *space); // to forget all the pages of a deleted space
+        void Discard(AddrSpace *space, unsigned vpn); // to forget a page which was unmapped
+        void Print(); // to report compression ratio and hit rates
+
+    private:
+        StoredPage **Lookup(AddrSpace *space, unsigned vpn);
+        void Free(StoredPage *p);
+        int SwapOut(const char *page); // returns the swap slot, or -1
+
+        StoredPage *buckets[NumStoreBuckets];
+        int poolSize;
+        int poolUsed;
+        OpenFile *swapFile; // opened on the first swap out
+        BitMap *swapSlots;
+
+        int numZero;        // pages stored, by kind
+        int numCompressed;
+        int numSwapped;
+        int bytesIn;        // size of the compressed pages before and
+        int bytesOut;       // after compression
+        int numZeroHits;    // pages loaded, by kind
+        int numPoolHits;
+        int numSwapHits;
+};
+
+#endif /* USERPROG_PAGESTORE_H_ */
@@ -33,12 +33,21 @@ StartProcess (char *filename)
 	  return;
       }
     space = new AddrSpace (executable);
+    if (space->IsStackFull ())
+      {
+	  printf ("[ERROR] %s needs %d pages, %s\n", filename,
+		  space->NumPages (), space->IsTooBig ()
+		  ? "more than the address space" : "not enough frames");
+	  delete space;
+	  return;
+      }
     currentThread->space = space;
 
-    delete executable;		// close file
+    // the address space keeps the executable open
 
+    scheduler->LoadUserState (currentThread);	// take the machine and
+    // load the page table register
     space->InitRegisters ();	// set the initial register values
-    space->RestoreState ();	// load page table register
 
     machine->Run ();		// jump to the user progam
     ASSERT (FALSE);		// machine->Run never returns;
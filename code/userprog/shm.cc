@@ -0,0 +1,105 @@
+#include "shm.h"
+#include "system.h"
+
+#include <strings.h>
+
+ShmTable::ShmTable() {
+    segments = NULL;
+    lock = new Semaphore("ShmTable", 1);
+    numCreated = 0;
+    numAttaches = 0;
+}
+
+ShmTable::~ShmTable() {
+    while (segments != NULL) {
+        ShmSegment *s = segments;
+        segments = s->next;
+        delete [] s->frames;
+        delete s;
+    }
+    delete lock;
+}
+
+ShmSegment **ShmTable::Lookup(int key) {
+    ShmSegment **link = &segments;
+    while (*link != NULL && (*link)->key != key) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+ShmSegment *ShmTable::Create(int key, int size) {
+    if (size <= 0) {
+        return NULL;
+    }
+
+    lock->P();
+    if (*Lookup(key) != NULL) {
+        lock->V();
+        printf("[ERROR] ShmCreate: key %d is already used\n", key);
+        return NULL;
+    }
+    ShmSegment *s = new ShmSegment;
+    s->key = key;
+    s->numPages = divRoundUp(size, PageSize);
+    s->frames = new int[s->numPages];
+    if (!frameProvider->GetEmptyFrames(s->numPages, s->frames)) {
+        lock->V();
+        printf("[ERROR] ShmCreate: no room for %d pages\n", s->numPages);
+        delete [] s->frames;
+        delete s;
+        return NULL;
+    }
+    for (int i = 0; i < s->numPages; i++) {
+        bzero(&machine->mainMemory[s->frames[i] * PageSize], PageSize);
+    }
+    s->numAttached = 1;
+    s->next = segments;
+    segments = s;
+    numCreated++;
+    numAttaches++;
+    lock->V();
+
+    DEBUG('a', "Shared segment %d created, %d pages\n", key, s->numPages);
+    return s;
+}
+
+ShmSegment *ShmTable::Attach(int key) {
+    lock->P();
+    ShmSegment *s = *Lookup(key);
+    if (s != NULL) {
+        for (int i = 0; i < s->numPages; i++) {
+            frameProvider->ShareFrame(s->frames[i]);
+        }
+        s->numAttached++;
+        numAttaches++;
+    }
+    lock->V();
+    return s;
+}
+
+void ShmTable::Detach(ShmSegment *segment) {
+    lock->P();
+    for (int i = 0; i < segment->numPages; i++) {
+        frameProvider->ReleaseFrame(segment->frames[i]);
+    }
+    if (--segment->numAttached == 0) {
+        DEBUG('a', "Shared segment %d destroyed\n", segment->key);
+        ShmSegment **link = Lookup(segment->key);
+        *link = segment->next;
+        delete [] segment->frames;
+        delete segment;
+    }
+    lock->V();
+}
+
+void ShmTable::Print() {
+    if (numCreated == 0) {
+        return;
+    }
+    printf("Shared memory: created %d segments, %d attaches\n", numCreated, numAttaches);
+    for (ShmSegment *s = segments; s != NULL; s = s->next) {
+        printf("\tsegment %d still alive, %d pages, %d attached\n",
+               s->key, s->numPages, s->numAttached);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef USERPROG_SHM_H_
+#define USERPROG_SHM_H_
+
+#include "synch.h"
+
+// A shared memory segment, named by a key
+typedef struct shmSegment_t {
+    int key;
+    int numPages;
+    int *frames;        // physical frames, in page order
+    int numAttached;    // address spaces mapping it
+    struct shmSegment_t *next;
+} ShmSegment;
+
+// Shared memory segments between processes.  The frames of a segment are
+// allocated, full of zeros, when it is created, and each address space
+// attached to it maps them in its page table: every attachment holds a
+// reference on every frame in the FrameProvider, and the frames are
+// freed with the last one.  They belong to no space, so they are never
+// evicted.  A segment disappears when the last space attached to it
+// detaches or exits.
+class ShmTable {
+    public:
+        ShmTable();
+        ~ShmTable();
+        ShmSegment *Create(int key, int size); // to create a segment and attach to it, NULL if key is used or memory is short
+        ShmSegment *Attach(int key); // to attach to a segment, NULL if there is none with this key
+        void Detach(ShmSegment *segment); // to drop an attachment
+        void Print(); // to report the segments still alive
+
+    private:
+        ShmSegment **Lookup(int key);
+
+        ShmSegment *segments;
+        Semaphore *lock;    // creating a segment may block on eviction
+        int numCreated;
+        int numAttaches;
+};
+
+#endif /* USERPROG_SHM_H_ */
@@ -41,6 +41,19 @@
 #define SC_UserThreadExit	18
 #define SC_UserThreadJoin	19
 #define SC_ForkExec         20
+#define SC_Mmap             21
+#define SC_Munmap           22
+#define SC_Sbrk             23
+#define SC_ShmCreate        24
+#define SC_ShmAttach        25
+#define SC_ShmDetach        26
+#define SC_UserThreadCreateN 27
+#define SC_FutexWait        28
+#define SC_FutexWake        29
+#define SC_SetPriority      30
+#define SC_SetTickets       31
+#define SC_SetRealTime      32
+#define SC_SetQuantum       33
 
 #ifdef IN_USER_MODE
 
@@ -152,14 +165,102 @@ int GetInt();
 
 void PutInt(int n);
 
+/* Start a thread running f(arg), return its id or -1.  Ids are never
+ * reused, and the number of threads is only limited by the room for
+ * their stacks.
+ */
 int UserThreadCreate(void f(void *arg), void *arg);
 
+/* Start "n" threads running f(args[i]) at once, with consecutive ids.
+ * Return the id of the first one, or -1 if they could not all be
+ * created, in which case none is.
+ */
+int UserThreadCreateN(void f(void *arg), void *args[], int n);
+
 void UserThreadExit();
 
-void UserThreadJoin(int tid);
+/* Wait for the thread "tid" to exit, return 0, or -1 if there is no such
+ * thread.
+ */
+int UserThreadJoin(int tid);
 
 int ForkExec(char *fileName);
 
+/* Map "length" bytes of the open file "id", from "offset" (a multiple of
+ * the page size) on, into the address space.  Pages are read from the
+ * file on their first access, and the modified ones are written back by
+ * Munmap, or when the program exits.  Return the address of the mapping,
+ * or (void *) -1.
+ */
+void *Mmap(OpenFileId id, int offset, int length);
+
+/* Unmap the file mapped at "addr" by Mmap, return 0 or -1. */
+int Munmap(void *addr);
+
+/* Move the end of the heap, which starts after the stack of the main
+ * thread, by "increment" bytes (possibly negative).  The new pages are
+ * given a frame, full of zeros, on their first access.  Return the
+ * previous end of the heap, or (void *) -1.
+ */
+void *Sbrk(int increment);
+
+/* Create a segment of "size" bytes of memory, full of zeros, which other
+ * programs can attach with the same "key", and attach it.  Return its
+ * address, or (void *) -1 if "key" is already used.
+ */
+void *ShmCreate(int key, int size);
+
+/* Attach the segment created with "key", return its address or
+ * (void *) -1.  Each program attaching it sees the same bytes.
+ */
+void *ShmAttach(int key);
+
+/* Detach the segment attached at "addr", return 0 or -1.  A segment is
+ * deleted when no program is attached to it any more, exiting detaches
+ * everything.
+ */
+int ShmDetach(void *addr);
+
+/* Sleep until FutexWake(addr), provided *addr still equals "expected"
+ * when the kernel looks at it.  Return 0 once woken, -1 if *addr
+ * differed.  For the synchronization library, test/usync.h.
+ */
+int FutexWait(int *addr, int expected);
+
+/* Wake up at most "n" threads sleeping in FutexWait(addr), return how
+ * many were.
+ */
+int FutexWake(int *addr, int n);
+
+/* Set the scheduling priority of thread "tid" of this program, from 0
+ * (the highest) to 63; 32 is the default, and threads start with the
+ * priority of their creator.  Only used when Nachos runs with -prio.
+ * Return the previous priority, or -1.
+ */
+int SetPriority(int tid, int priority);
+
+/* Set the CPU tickets of this program, from 1 to 10000; 100 is the
+ * default.  With -stride or -lottery, programs get CPU time in
+ * proportion to their tickets, shared by their threads.  Return the
+ * previous number, or -1.
+ */
+int SetTickets(int tickets);
+
+/* Make the calling thread real-time: it then gets "budget" ticks of CPU
+ * in every period of "period" ticks (at least 100), before any other
+ * thread, the earliest deadline -- end of period -- first.  A 0 budget
+ * makes it an ordinary thread again.  Return 0, or -1 if the real-time
+ * threads would use more than 90% of the CPU.
+ */
+int SetRealTime(int budget, int period);
+
+/* Set the quantum of the calling thread: the ticks it may run before
+ * another thread of its level gets the CPU, whatever the policy.  0
+ * restores the default one.  Return the previous value (0 for the
+ * default), or -1.
+ */
+int SetQuantum(int ticks);
+
 #endif // IN_USER_MODE
 
 #endif /* SYSCALL_H */
@@ -3,116 +3,299 @@
 #include "thread.h"
 #include "addrspace.h"
 
-static Semaphore *wait = new Semaphore("Thread wait", 0);
-static Semaphore *isThreadExist = new Semaphore("ThreadExisting", 1);
-
-// Init registers similar to Machine::InitRegisters and then run Machine::Run
-// Also save and restore current state before starting to run new context
-void StartUserThread(int fun) {
-    threadFun *tfun = (threadFun*) fun;
-
-    currentThread->space->SaveState();
-    currentThread->space->InitRegisters();
-
-    machine->WriteRegister(PCReg, tfun->f);
-    machine->WriteRegister(NextPCReg, (tfun->f) + 4);
-    machine->WriteRegister(4, tfun->arg);
-
-    int allocStack = currentThread->space->UserStackAllocate();
+UserThreadTable::UserThreadTable() {
+    for (int i = 0; i < NumThreadBuckets; i++) {
+        buckets[i] = NULL;
+    }
+    lock = new Semaphore("UserThreadTable", 1);
+    nextTid = 1;
+    numThreads = 0;
+    waitingAll = false;
+    allDone = new Semaphore("AllThreadsDone", 0);
+}
 
-    machine->WriteRegister(StackReg, currentThread->space->GetStack(allocStack));
+UserThreadTable::~UserThreadTable() {
+    for (int i = 0; i < NumThreadBuckets; i++) {
+        while (buckets[i] != NULL) {
+            UserThreadEntry *e = buckets[i];
+            buckets[i] = e->next;
+            delete e->done;
+            delete e;
+        }
+    }
+    delete lock;
+    delete allDone;
+}
 
-    currentThread->initStackReg = allocStack;
+UserThreadEntry **UserThreadTable::Lookup(int tid) {
+    UserThreadEntry **link = &buckets[tid % NumThreadBuckets];
+    while (*link != NULL && (*link)->tid != tid) {
+        link = &(*link)->next;
+    }
+    return link;
+}
 
-    // Increment the wait threads semaphore as new thread has been created
-    wait->V();
-    
-    machine->Run();
+void UserThreadTable::Remove(UserThreadEntry *entry) {
+    *Lookup(entry->tid) = entry->next;
+    delete entry->done;
+    delete entry;
 }
 
-int do_UserThreadCreate(int f, int arg) {
-    if (!currentThread->space->IsStackFree()) {
-        printf("[ERROR] UserThread stack FULL!\n");
-        return -1;
+int UserThreadTable::Add(Thread **threads, int n) {
+    lock->P();
+    int first = nextTid;
+    for (int i = 0; i < n; i++) {
+        UserThreadEntry *e = new UserThreadEntry;
+        e->tid = nextTid++;
+        e->thread = threads[i];
+        e->exited = false;
+        e->numJoiners = 0;
+        e->done = new Semaphore("ThreadJoin", 0);
+        e->next = buckets[e->tid % NumThreadBuckets];
+        buckets[e->tid % NumThreadBuckets] = e;
     }
+    numThreads += n;
+    lock->V();
+    return first;
+}
 
-    Thread *newThread = new Thread("User Thread");
+void UserThreadTable::Exit(int tid) {
+    lock->P();
+    UserThreadEntry *e = *Lookup(tid);
+    ASSERT(e != NULL && !e->exited);
+    e->exited = true;
+    if (e->numJoiners == 0) {
+        Remove(e);
+    } else {
+        // the last of them to wake up removes it
+        for (int i = 0; i < e->numJoiners; i++) {
+            e->done->V();
+        }
+    }
+    if (--numThreads == 0 && waitingAll) {
+        waitingAll = false;
+        allDone->V();
+    }
+    lock->V();
+}
 
-    if (newThread == NULL) {
-        printf("[ERROR] Failed to create UserThread!\n");
+int UserThreadTable::Join(int tid) {
+    lock->P();
+    UserThreadEntry *e = *Lookup(tid);
+    if (e == NULL || e->exited) {
+        lock->V();
+        if (tid <= 0 || tid >= nextTid) {
+            printf("[ERROR] UserThread calling JOIN on a non existing thread!\n");
+            return -1;
+        }
+        return 0;
+    }
+    if (e->thread == currentThread) {
+        lock->V();
+        printf("[ERROR] UserThread trying to call JOIN on itself!\n");
         return -1;
     }
+    e->numJoiners++;
+    lock->V();
 
-    isThreadExist->P();
-
-    threadFun *fn = new threadFun;
+    e->done->P();
 
-    fn->f = f;
-    fn->arg = arg;
+    lock->P();
+    if (--e->numJoiners == 0) {
+        Remove(e);
+    }
+    lock->V();
+    return 0;
+}
 
-    newThread->Fork(StartUserThread, (int)fn);
+void UserThreadTable::WaitAll() {
+    lock->P();
+    if (numThreads == 0) {
+        lock->V();
+        return;
+    }
+    waitingAll = true;
+    lock->V();
+    allDone->P();
+}
 
-    wait->P();
+int UserThreadTable::NumThreads() {
+    return numThreads;
+}
 
-    currentThread->space->SemForJoins[newThread->initStackReg]->P();
+// The thread cannot finish while we hold the lock, Exit needs it
+int UserThreadTable::SetPriority(int tid, int priority) {
+    lock->P();
+    UserThreadEntry *e = *Lookup(tid);
+    if (e == NULL || e->exited) {
+        lock->V();
+        return -1;
+    }
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int old = SetBasePriority(e->thread, priority);
+    (void) interrupt->SetLevel(oldLevel);
+    lock->V();
+    return old;
+}
 
-    machine->WriteRegister(2, newThread->initStackReg);
+// The user registers of the thread were set by its creator, and are
+// loaded when it first runs: there is nothing left but to run
+void StartUserThread(int unused) {
+    machine->Run();
+}
 
-    isThreadExist->V();
+// Returns the id of the new thread, or -1
+int do_UserThreadCreate(int f, int arg) {
+    return do_UserThreadCreateN(f, &arg, 1);
+}
 
-    currentThread->Yield();
+//----------------------------------------------------------------------
+// do_UserThreadCreateN
+//      Create "n" threads running f(args[i]), with consecutive ids.
+//      Everything is set up here, in the creator: the stack, the user
+//      registers and the entry in the thread table.  The threads are
+//      then only put on the ready list, the creator does not wait for
+//      them to run.  Either all of them are created, or none.
+//
+//      Returns the id of the first thread, or -1.
+//----------------------------------------------------------------------
+
+int do_UserThreadCreateN(int f, int *args, int n) {
+    AddrSpace *space = currentThread->space;
+    Thread **threads = new Thread *[n];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        int slot = space->AllocateThreadStack();
+        if (slot < 0) {
+            break;
+        }
+        threads[i] = new Thread("User Thread");
+        threads[i]->stackSlot = slot;
+    }
+    if (i < n) {
+        printf("[ERROR] No room left for %d UserThread stacks!\n", n);
+        while (--i >= 0) {
+            space->ReleaseThreadStack(threads[i]->stackSlot);
+            delete threads[i];
+        }
+        delete [] threads;
+        return -1;
+    }
 
-    return 0;
+    int first = space->Threads()->Add(threads, n);
+    for (i = 0; i < n; i++) {
+        Thread *t = threads[i];
+        t->tid = first + i;
+        for (int r = 0; r < NumTotalRegs; r++) {
+            t->SetUserRegister(r, 0);
+        }
+        t->SetUserRegister(PCReg, f);
+        t->SetUserRegister(NextPCReg, f + 4);
+        t->SetUserRegister(4, args[i]);
+        t->SetUserRegister(StackReg, space->ThreadStackTop(t->stackSlot));
+        t->Fork(StartUserThread, 0);
+    }
+    delete [] threads;
+    return first;
 }
 
 // Thread will call the finish method to exit
 int do_UserThreadExit() {
 
-    if (currentThread->initStackReg == 0) return 0;
-
-    currentThread->space->SemForJoins[currentThread->initStackReg]->V();
-
-    // Release any dependent thread to the current thread
-    if (currentThread->dependentTID != -1) {
-        currentThread->space->SemForJoins[currentThread->dependentTID]->V();
-    }
+    if (currentThread->tid == 0) return 0;
 
     // De-allocate the stack which has been allocated for the current thread
-    currentThread->space->RevokeStack(currentThread->initStackReg);
+    currentThread->space->ReleaseThreadStack(currentThread->stackSlot);
+
+    // Release the threads joining the current thread.  No preemption
+    // from there on: once the last thread is gone the process may be
+    // deleted, this one must not be on a ready list any more
+    (void) interrupt->SetLevel(IntOff);
+    currentThread->space->Threads()->Exit(currentThread->tid);
     currentThread->Finish();
 
     return 0;
 }
 
 int UserThreadJoin(int tid) {
+    return currentThread->space->Threads()->Join(tid);
+}
 
-    // Current thread is already waiting on another thread
-    // We prevent multiple calls to join by the same thread
-    if (currentThread->dependentTID != -1) {
-        printf("[ERROR] UserThread is dependent already on another thread!\n");
+//----------------------------------------------------------------------
+// do_SetPriority
+//      Set the scheduling priority of the thread "tid" of the current
+//      process: the caller itself, or one of the threads it created.
+//      The main thread (tid 0) can only set its own.  Yields if a thread
+//      of a higher priority than the caller is now ready.
+//
+//      Returns the previous priority, or -1.
+//----------------------------------------------------------------------
+
+int do_SetPriority(int tid, int priority) {
+    int old;
+
+    if (priority < 0 || priority >= NumPriorities) {
+        printf("[ERROR] Priority %d out of range [0, %d]!\n", priority, NumPriorities - 1);
         return -1;
     }
-
-    // We prevent thread calling join to itself
-    if (currentThread->initStackReg == tid || tid == 0) {
-        printf("[ERROR] UserThread trying to call JOIN on an invalid thread!\n");
-        return -1;
+    if (tid == currentThread->tid) {
+        IntStatus oldLevel = interrupt->SetLevel(IntOff);
+        old = SetBasePriority(currentThread, priority);
+        (void) interrupt->SetLevel(oldLevel);
+    } else {
+        old = currentThread->space->Threads()->SetPriority(tid, priority);
+        if (old < 0) {
+            printf("[ERROR] SetPriority on a non existing thread %d!\n", tid);
+            return -1;
+        }
     }
 
-    // Check if the passed tid already has an allocated stack
-    isThreadExist->P();
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    if (scheduler->Outranked()) {
+        currentThread->Yield();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+    return old;
+}
 
-    if (!currentThread->space->Test(tid)) {
-        printf("[ERROR] UserThread calling JOIN on a non existing thread!\n");
-        isThreadExist->V();
+//----------------------------------------------------------------------
+// do_SetRealTime
+//      Move the current thread to the real-time class, with "budget"
+//      ticks of CPU every "period" ticks, or back to best-effort with a
+//      0 budget.
+//
+//      Returns 0, or -1 if the arguments are wrong or admission control
+//      refuses the thread.
+//----------------------------------------------------------------------
+
+int do_SetRealTime(int budget, int period) {
+    if (budget < 0 || (budget > 0 && (budget > period || period < RtMinPeriod))) {
+        printf("[ERROR] Real-time budget %d period %d is invalid!\n", budget, period);
         return -1;
     }
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int res = scheduler->SetRealTime(currentThread, budget, period);
+    (void) interrupt->SetLevel(oldLevel);
+    return res;
+}
 
-    isThreadExist->V();
-
-    // Set the passed tid as current thread's dependent
-    currentThread->dependentTID = tid;
-    // Wait for the completion of passed tid
-    currentThread->space->SemForJoins[tid]->P();
-    return 0;
-}
\ No newline at end of file
+//----------------------------------------------------------------------
+// do_SetQuantum
+//      Set the quantum of the current thread, 0 for the one of the
+//      policy.  It is inherited by the threads it creates.
+//
+//      Returns the previous quantum, or -1.
+//----------------------------------------------------------------------
+
+int do_SetQuantum(int ticks) {
+    if (ticks < 0 || ticks > MaxQuantum) {
+        printf("[ERROR] Quantum %d out of range [0, %d]!\n", ticks, MaxQuantum);
+        return -1;
+    }
+    int old = currentThread->timeSlice;
+    currentThread->timeSlice = ticks;
+    if (ticks > 0)
+        EnableTimeSlicing();	// FIFO may not have started the timer
+    return old;
+}
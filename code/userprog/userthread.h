@@ -2,15 +2,55 @@
 #define USERTHREAD_H
 
 #include "thread.h"
+#include "synch.h"
 
-typedef struct threadFun_t {
-    int f;
-    int arg;
-} threadFun;
+#define NumThreadBuckets 64
+
+// A user thread which has not exited yet, or which has exited but still
+// has threads waiting to join it
+typedef struct userThreadEntry_t {
+    int tid;
+    Thread *thread;
+    bool exited;
+    int numJoiners;     // threads waiting in Join
+    Semaphore *done;    // V'ed once for each of them at exit
+    struct userThreadEntry_t *next; // in the hash bucket
+} UserThreadEntry;
+
+// The user threads of a process, found by their thread id.  Ids are
+// never reused: a thread is forgotten as soon as it exited and nobody
+// waits for it, and joining an id which is gone returns at once.  The
+// main thread has id 0 and is not in the table.
+class UserThreadTable {
+    public:
+        UserThreadTable();
+        ~UserThreadTable();
+        int Add(Thread **threads, int n); // to register new threads, returns the first of their consecutive ids
+        void Exit(int tid); // to wake up the threads joining it
+        int Join(int tid); // to wait for a thread, -1 if it never existed
+        void WaitAll(); // to wait until all the threads exited
+        int NumThreads(); // threads which did not exit yet
+        int SetPriority(int tid, int priority); // returns the previous priority, -1 if the thread exited
+
+    private:
+        UserThreadEntry **Lookup(int tid);
+        void Remove(UserThreadEntry *entry);
+
+        UserThreadEntry *buckets[NumThreadBuckets];
+        Semaphore *lock;
+        int nextTid;
+        int numThreads;
+        bool waitingAll;
+        Semaphore *allDone; // V'ed when numThreads drops to 0
+};
 
 extern int do_UserThreadCreate(int f, int arg);
+extern int do_UserThreadCreateN(int f, int *args, int n);
 extern int do_UserThreadExit();
 extern void StartUserThread(int f);
 extern int UserThreadJoin(int tid);
+extern int do_SetPriority(int tid, int priority);
+extern int do_SetRealTime(int budget, int period);
+extern int do_SetQuantum(int ticks);
 
-#endif
\ No newline at end of file
+#endif
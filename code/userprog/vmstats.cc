@@ -0,0 +1,80 @@
+#include "vmstats.h"
+#include "system.h"
+
+static const char *causeNames[NUM_FAULT_CAUSES] = { "zero", "file", "pool", "swap" };
+
+VmStats::VmStats() {
+    for (int i = 0; i < NUM_FAULT_CAUSES; i++) {
+        numFaults[i] = 0;
+        totalLatency[i] = 0;
+        maxLatency[i] = 0;
+        for (int j = 0; j < NumLatencyBuckets; j++) {
+            histogram[i][j] = 0;
+        }
+    }
+    numEvictions = 0;
+    numRss = 0;
+}
+
+void VmStats::RecordFault(FaultCause cause, long long latency) {
+    int bucket = 0;
+    while (bucket < NumLatencyBuckets - 1 && latency >= (1LL << bucket)) {
+        bucket++;
+    }
+    numFaults[cause]++;
+    histogram[cause][bucket]++;
+    totalLatency[cause] += latency;
+    if (latency > maxLatency[cause]) {
+        maxLatency[cause] = latency;
+    }
+}
+
+void VmStats::RecordEviction() {
+    numEvictions++;
+}
+
+void VmStats::RecordRss(int rss) {
+    int last = (numRss - 1) % RssHistorySize;
+    if (numRss > 0 && stats->totalTicks - rssTicks[last] < RssSampleTicks) {
+        rssValues[last] = rss;
+        return;
+    }
+    rssTicks[numRss % RssHistorySize] = stats->totalTicks;
+    rssValues[numRss % RssHistorySize] = rss;
+    numRss++;
+}
+
+void VmStats::Print(const char *name) {
+    int total = 0;
+    for (int i = 0; i < NUM_FAULT_CAUSES; i++) {
+        total += numFaults[i];
+    }
+    printf("VM %s: faults %d (", name, total);
+    for (int i = 0; i < NUM_FAULT_CAUSES; i++) {
+        printf("%s%s %d", i > 0 ? ", " : "", causeNames[i], numFaults[i]);
+    }
+    printf("), evictions %d\n", numEvictions);
+
+    for (int i = 0; i < NUM_FAULT_CAUSES; i++) {
+        if (numFaults[i] == 0) {
+            continue;
+        }
+        printf("\t%s latency: mean %lld, max %lld ticks;", causeNames[i],
+               totalLatency[i] / numFaults[i], maxLatency[i]);
+        for (int j = 0; j < NumLatencyBuckets; j++) {
+            if (histogram[i][j] > 0) {
+                printf(" [%lld+] %d", j == 0 ? 0 : 1LL << (j - 1), histogram[i][j]);
+            }
+        }
+        printf("\n");
+    }
+
+    if (numRss > 0) {
+        int first = numRss > RssHistorySize ? numRss - RssHistorySize : 0;
+        printf("\tresident pages:");
+        for (int i = first; i < numRss; i++) {
+            printf(" %d@%lld", rssValues[i % RssHistorySize], rssTicks[i % RssHistorySize]);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef USERPROG_VMSTATS_H_
+#define USERPROG_VMSTATS_H_
+
+// Where the page brought in by a page fault came from
+enum FaultCause {
+    FAULT_ZERO,     // a page of zeros, nothing to read
+    FAULT_FILE,     // read from a mapped file
+    FAULT_POOL,     // decompressed from the page store pool
+    FAULT_SWAP,     // read back from the swap file
+    NUM_FAULT_CAUSES
+};
+
+// Fault latencies are counted in buckets of powers of 2 ticks: bucket 0
+// is 0 tick, bucket i is [2^(i-1), 2^i), the last one takes the rest
+#define NumLatencyBuckets   16
+
+// The resident set size is recorded at most every RssSampleTicks, the
+// last RssHistorySize records are kept
+#define RssSampleTicks      1000
+#define RssHistorySize      16
+
+// Virtual memory telemetry, of one process or of the whole machine
+class VmStats {
+    public:
+        VmStats();
+
+        void RecordFault(FaultCause cause, long long latency);
+        void RecordEviction();
+        void RecordRss(int rss); // to be called when the resident set changes
+        void Print(const char *name);
+
+    private:
+        int numFaults[NUM_FAULT_CAUSES];
+        int histogram[NUM_FAULT_CAUSES][NumLatencyBuckets];
+        long long totalLatency[NUM_FAULT_CAUSES];
+        long long maxLatency[NUM_FAULT_CAUSES];
+        int numEvictions;
+
+        long long rssTicks[RssHistorySize]; // ring of (ticks, rss) records
+        int rssValues[RssHistorySize];
+        int numRss;
+};
+
+#endif /* USERPROG_VMSTATS_H_ */